@@ -0,0 +1,522 @@
+#include "config.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+
+#include "hash.h"
+#include "mapped_file.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+
+#include "event_log.h"
+#include "utils.h"
+#endif
+
+namespace {
+	constexpr std::uint32_t SNAPSHOT_MAGIC = 0x31434654; // "TFC1"
+	constexpr std::uint32_t SNAPSHOT_VERSION = 1;
+	constexpr std::uint32_t MAX_TARGETS = 64;
+
+	/// <summary>
+	/// The header at the start of a snapshot. It's followed by the string references (the task
+	/// name, the task delay and then one for every target), and then by the strings themselves
+	/// as UTF-16 code units.
+	/// </summary>
+	struct SnapshotHeader {
+		std::uint32_t magic;
+		std::uint32_t version;
+		std::uint32_t size;
+		std::uint32_t checksum;
+		std::uint32_t timeoutMs;
+		std::uint32_t targetCount;
+		std::uint32_t reserved[2];
+	};
+
+	/// <summary>
+	/// Where a string is in the snapshot. The offset is in bytes from the start of the snapshot,
+	/// and the length is in UTF-16 code units.
+	/// </summary>
+	struct StringRef {
+		std::uint32_t offset;
+		std::uint32_t length;
+	};
+
+	static_assert(sizeof(SnapshotHeader) == 32, "The snapshot header must stay 32 bytes");
+	static_assert(sizeof(StringRef) == 8, "A string reference must stay 8 bytes");
+
+	// NOTE: The checksum covers everything after the checksum itself.
+	constexpr std::size_t CHECKSUM_START = offsetof(SnapshotHeader, checksum) + sizeof(std::uint32_t);
+
+	std::uint32_t ComputeChecksum(const unsigned char* data, std::size_t size)
+	{
+		std::uint64_t hash = Hash::Fnv1a(Hash::FNV_OFFSET_BASIS, data + CHECKSUM_START, size - CHECKSUM_START);
+		return static_cast<std::uint32_t>(hash ^ (hash >> 32));
+	}
+
+	std::string Trim(const std::string& value)
+	{
+		const char* whitespace = " \t\r";
+		std::size_t start = value.find_first_not_of(whitespace);
+		if (start == std::string::npos) {
+			return std::string();
+		}
+
+		std::size_t end = value.find_last_not_of(whitespace);
+		return value.substr(start, end - start + 1);
+	}
+
+	bool IsHighSurrogate(std::uint32_t codeUnit)
+	{
+		return codeUnit >= 0xD800 && codeUnit <= 0xDBFF;
+	}
+
+	bool IsLowSurrogate(std::uint32_t codeUnit)
+	{
+		return codeUnit >= 0xDC00 && codeUnit <= 0xDFFF;
+	}
+
+	void AppendCodePoint(std::wstring& output, std::uint32_t codePoint)
+	{
+		if (sizeof(wchar_t) == 2 && codePoint > 0xFFFF) {
+			codePoint -= 0x10000;
+			output += static_cast<wchar_t>(0xD800 + (codePoint >> 10));
+			output += static_cast<wchar_t>(0xDC00 + (codePoint & 0x3FF));
+		}
+		else {
+			output += static_cast<wchar_t>(codePoint);
+		}
+	}
+
+	bool DecodeUtf8(const std::string& input, std::wstring& output)
+	{
+		output.clear();
+		for (std::size_t i = 0; i < input.size();) {
+			auto lead = static_cast<unsigned char>(input[i]);
+			std::size_t length;
+			std::uint32_t codePoint;
+			if (lead < 0x80) {
+				length = 1;
+				codePoint = lead;
+			}
+			else if ((lead & 0xE0) == 0xC0) {
+				length = 2;
+				codePoint = lead & 0x1F;
+			}
+			else if ((lead & 0xF0) == 0xE0) {
+				length = 3;
+				codePoint = lead & 0x0F;
+			}
+			else if ((lead & 0xF8) == 0xF0) {
+				length = 4;
+				codePoint = lead & 0x07;
+			}
+			else {
+				return false;
+			}
+
+			if (i + length > input.size()) {
+				return false;
+			}
+
+			for (std::size_t j = 1; j < length; ++j) {
+				auto continuation = static_cast<unsigned char>(input[i + j]);
+				if ((continuation & 0xC0) != 0x80) {
+					return false;
+				}
+
+				codePoint = (codePoint << 6) | (continuation & 0x3F);
+			}
+
+			if (codePoint > 0x10FFFF) {
+				return false;
+			}
+
+			AppendCodePoint(output, codePoint);
+			i += length;
+		}
+
+		return true;
+	}
+
+	std::vector<std::uint16_t> EncodeUtf16(const std::wstring& value)
+	{
+		// NOTE: wchar_t is UTF-16 on Windows already, so this only ever splits anything up where
+		// wchar_t is UTF-32.
+		std::vector<std::uint16_t> output;
+		output.reserve(value.size());
+		for (wchar_t ch : value) {
+			auto codePoint = static_cast<std::uint32_t>(ch);
+			if (codePoint > 0xFFFF) {
+				codePoint -= 0x10000;
+				output.push_back(static_cast<std::uint16_t>(0xD800 + (codePoint >> 10)));
+				output.push_back(static_cast<std::uint16_t>(0xDC00 + (codePoint & 0x3FF)));
+			}
+			else {
+				output.push_back(static_cast<std::uint16_t>(codePoint));
+			}
+		}
+
+		return output;
+	}
+
+	bool IsValidDuration(const std::string& value)
+	{
+		// The Task Scheduler takes an ISO 8601 duration of the form PnYnMnDTnHnMnS: every part is
+		// optional, but the parts that are given must be in that order, and there has to be at
+		// least one after the P and after the T.
+		if (value.size() < 2 || value[0] != 'P') {
+			return false;
+		}
+
+		const std::string dateUnits = "YMD";
+		const std::string timeUnits = "HMS";
+		bool inTime = false;
+		bool hasPart = false;
+		std::size_t nextUnit = 0;
+		for (std::size_t i = 1; i < value.size();) {
+			if (value[i] == 'T') {
+				if (inTime) {
+					return false;
+				}
+
+				inTime = true;
+				hasPart = false;
+				nextUnit = 0;
+				++i;
+				continue;
+			}
+
+			std::size_t digits = i;
+			while (i < value.size() && value[i] >= '0' && value[i] <= '9') {
+				++i;
+			}
+
+			if (i == digits || i == value.size()) {
+				return false;
+			}
+
+			std::size_t unit = (inTime ? timeUnits : dateUnits).find(value[i], nextUnit);
+			if (unit == std::string::npos) {
+				return false;
+			}
+
+			nextUnit = unit + 1;
+			hasPart = true;
+			++i;
+		}
+
+		return hasPart;
+	}
+
+	bool ParseUInt32(const std::string& value, std::uint32_t& result)
+	{
+		if (value.empty() || value.size() > 10 || value.find_first_not_of("0123456789") != std::string::npos) {
+			return false;
+		}
+
+		std::uint64_t parsed = std::stoull(value);
+		if (parsed > UINT32_MAX) {
+			return false;
+		}
+
+		result = static_cast<std::uint32_t>(parsed);
+		return true;
+	}
+
+	template <typename T>
+	void Write(std::vector<unsigned char>& output, std::size_t offset, const T& value)
+	{
+		std::memcpy(output.data() + offset, &value, sizeof(T));
+	}
+
+	template <typename T>
+	T Read(const unsigned char* data, std::size_t offset)
+	{
+		T value;
+		std::memcpy(&value, data + offset, sizeof(T));
+
+		return value;
+	}
+
+	bool ReadString(const unsigned char* data, std::size_t size, const StringRef& ref, std::wstring& value)
+	{
+		if (ref.offset % sizeof(std::uint16_t) != 0
+			|| ref.offset > size
+			|| ref.length > (size - ref.offset) / sizeof(std::uint16_t)) {
+			return false;
+		}
+
+		value.clear();
+		value.reserve(ref.length);
+		for (std::uint32_t i = 0; i < ref.length; ++i) {
+			std::uint32_t codeUnit = Read<std::uint16_t>(data, ref.offset + i * sizeof(std::uint16_t));
+			if (IsHighSurrogate(codeUnit) && i + 1 < ref.length) {
+				std::uint32_t next = Read<std::uint16_t>(data, ref.offset + (i + 1) * sizeof(std::uint16_t));
+				if (IsLowSurrogate(next)) {
+					AppendCodePoint(value, 0x10000 + ((codeUnit - 0xD800) << 10) + (next - 0xDC00));
+					++i;
+					continue;
+				}
+			}
+
+			value += static_cast<wchar_t>(codeUnit);
+		}
+
+		return true;
+	}
+}
+
+Config GetDefaultConfig()
+{
+	Config config;
+	config.targets = { L"Progman" };
+	config.timeoutMs = 500;
+	config.taskName = L"Transition Fixer";
+	config.taskDelay = L"PT30S"; // Put a 30s delay, in case Explorer hasn't initialized immediately.
+
+	return config;
+}
+
+bool ParseConfig(const std::string& text, Config& config, std::string& error)
+{
+	config = GetDefaultConfig();
+
+	// Skip the UTF-8 byte order mark, if there is one.
+	std::size_t start = text.compare(0, 3, "\xEF\xBB\xBF") == 0 ? 3 : 0;
+
+	bool sawTarget = false;
+	std::istringstream stream(text.substr(start));
+	std::string line;
+	for (int lineNumber = 1; std::getline(stream, line); ++lineNumber) {
+		line = Trim(line);
+		if (line.empty() || line[0] == '#') {
+			continue;
+		}
+
+		std::size_t separator = line.find('=');
+		if (separator == std::string::npos) {
+			error = "line " + std::to_string(lineNumber) + ": expected 'key = value'";
+			return false;
+		}
+
+		std::string key = Trim(line.substr(0, separator));
+		std::string value = Trim(line.substr(separator + 1));
+		std::wstring wideValue;
+		if (!DecodeUtf8(value, wideValue)) {
+			error = "line " + std::to_string(lineNumber) + ": value is not valid UTF-8";
+			return false;
+		}
+
+		if (key == "target") {
+			if (!sawTarget) {
+				config.targets.clear();
+				sawTarget = true;
+			}
+
+			if (wideValue.empty() || config.targets.size() == MAX_TARGETS) {
+				error = "line " + std::to_string(lineNumber) + ": target must not be empty, and there can be at most "
+					+ std::to_string(MAX_TARGETS) + " targets";
+				return false;
+			}
+
+			config.targets.push_back(wideValue);
+		}
+		else if (key == "timeout-ms") {
+			if (!ParseUInt32(value, config.timeoutMs) || config.timeoutMs == 0) {
+				error = "line " + std::to_string(lineNumber) + ": timeout-ms must be a positive number";
+				return false;
+			}
+		}
+		else if (key == "task-name") {
+			if (wideValue.empty()) {
+				error = "line " + std::to_string(lineNumber) + ": task-name must not be empty";
+				return false;
+			}
+
+			config.taskName = wideValue;
+		}
+		else if (key == "task-delay") {
+			if (!IsValidDuration(value)) {
+				error = "line " + std::to_string(lineNumber) + ": task-delay must be an ISO 8601 duration (e.g. PT30S)";
+				return false;
+			}
+
+			config.taskDelay = wideValue;
+		}
+		else {
+			error = "line " + std::to_string(lineNumber) + ": unrecognized key '" + key + "'";
+			return false;
+		}
+	}
+
+	return true;
+}
+
+std::vector<unsigned char> CompileConfig(const Config& config)
+{
+	std::vector<std::vector<std::uint16_t>> strings = { EncodeUtf16(config.taskName), EncodeUtf16(config.taskDelay) };
+	for (const auto& target : config.targets) {
+		strings.push_back(EncodeUtf16(target));
+	}
+
+	std::size_t size = sizeof(SnapshotHeader) + strings.size() * sizeof(StringRef);
+	for (const auto& value : strings) {
+		size += value.size() * sizeof(std::uint16_t);
+	}
+
+	std::vector<unsigned char> output(size, 0);
+
+	SnapshotHeader header = {};
+	header.magic = SNAPSHOT_MAGIC;
+	header.version = SNAPSHOT_VERSION;
+	header.size = static_cast<std::uint32_t>(size);
+	header.timeoutMs = config.timeoutMs;
+	header.targetCount = static_cast<std::uint32_t>(config.targets.size());
+
+	std::size_t refOffset = sizeof(SnapshotHeader);
+	std::size_t charOffset = refOffset + strings.size() * sizeof(StringRef);
+	for (const auto& value : strings) {
+		StringRef ref;
+		ref.offset = static_cast<std::uint32_t>(charOffset);
+		ref.length = static_cast<std::uint32_t>(value.size());
+		Write(output, refOffset, ref);
+		refOffset += sizeof(StringRef);
+
+		for (std::uint16_t codeUnit : value) {
+			Write(output, charOffset, codeUnit);
+			charOffset += sizeof(std::uint16_t);
+		}
+	}
+
+	Write(output, 0, header);
+	header.checksum = ComputeChecksum(output.data(), output.size());
+	Write(output, 0, header);
+
+	return output;
+}
+
+bool LoadConfigSnapshot(const void* data, std::size_t size, Config& config)
+{
+	// Everything is at a fixed offset, so loading the snapshot is just a matter of checking that
+	// it's intact and copying the values out.
+	const auto* bytes = static_cast<const unsigned char*>(data);
+	if (bytes == nullptr || size < sizeof(SnapshotHeader)) {
+		return false;
+	}
+
+	auto header = Read<SnapshotHeader>(bytes, 0);
+	if (header.magic != SNAPSHOT_MAGIC
+		|| header.version != SNAPSHOT_VERSION
+		|| header.size != size
+		|| header.targetCount == 0
+		|| header.targetCount > MAX_TARGETS
+		|| header.timeoutMs == 0
+		|| header.checksum != ComputeChecksum(bytes, size)) {
+		return false;
+	}
+
+	std::size_t stringCount = 2 + header.targetCount;
+	if (sizeof(SnapshotHeader) + stringCount * sizeof(StringRef) > size) {
+		return false;
+	}
+
+	Config loaded;
+	loaded.timeoutMs = header.timeoutMs;
+	loaded.targets.resize(header.targetCount);
+
+	std::size_t refOffset = sizeof(SnapshotHeader);
+	auto readNext = [&](std::wstring& value) {
+		auto ref = Read<StringRef>(bytes, refOffset);
+		refOffset += sizeof(StringRef);
+
+		return ReadString(bytes, size, ref, value);
+	};
+
+	if (!readNext(loaded.taskName) || !readNext(loaded.taskDelay)) {
+		return false;
+	}
+
+	for (auto& target : loaded.targets) {
+		if (!readNext(target)) {
+			return false;
+		}
+	}
+
+	config = std::move(loaded);
+	return true;
+}
+
+bool CompileConfigFile(const std::wstring& inputPath, const std::wstring& outputPath, std::string& error)
+{
+	std::ifstream input(std::filesystem::path(inputPath), std::ios::binary);
+	if (!input) {
+		error = "failed to open the config file";
+		return false;
+	}
+
+	std::string text((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+
+	Config config;
+	if (!ParseConfig(text, config, error)) {
+		return false;
+	}
+
+	std::vector<unsigned char> snapshot = CompileConfig(config);
+	std::ofstream output(std::filesystem::path(outputPath), std::ios::binary | std::ios::trunc);
+	output.write(reinterpret_cast<const char*>(snapshot.data()), static_cast<std::streamsize>(snapshot.size()));
+	if (!output) {
+		error = "failed to write the snapshot";
+		return false;
+	}
+
+	return true;
+}
+
+bool LoadConfigSnapshotFile(const std::wstring& path, Config& config)
+{
+	MappedFile file;
+	if (!file.Open(path, MappedFileAccess::ReadOnly)) {
+		return false;
+	}
+
+	return LoadConfigSnapshot(file.GetData(), file.GetSize(), config);
+}
+
+#ifdef _WIN32
+
+std::wstring GetConfigSnapshotPath()
+{
+	std::wstring exePath = GetExePath();
+	if (exePath.empty()) {
+		return std::wstring();
+	}
+
+	return exePath.substr(0, exePath.find_last_of('\\')) + L"\\TransitionFixer.config.bin";
+}
+
+const Config& GetConfig()
+{
+	static const Config config = [] {
+		Config loaded = GetDefaultConfig();
+		std::wstring path = GetConfigSnapshotPath();
+		if (path.empty() || GetFileAttributesW(path.c_str()) == INVALID_FILE_ATTRIBUTES) {
+			// No snapshot, so stick with the defaults.
+			return loaded;
+		}
+
+		if (!LoadConfigSnapshotFile(path, loaded)) {
+			LogError(L"Config snapshot " + path + L" is invalid, using the defaults instead");
+			loaded = GetDefaultConfig();
+		}
+
+		return loaded;
+	}();
+
+	return config;
+}
+
+#endif
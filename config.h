@@ -0,0 +1,94 @@
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/// <summary>
+/// The values that can be tuned per deployment.
+/// </summary>
+struct Config {
+	/// <summary>The window classes to send the "enable Active Desktop" message to, in the order they should be tried.</summary>
+	std::vector<std::wstring> targets;
+
+	/// <summary>How long to wait for a target window to process the message, in milliseconds.</summary>
+	std::uint32_t timeoutMs = 0;
+
+	/// <summary>The name the task is registered under in the Windows Task Scheduler.</summary>
+	std::wstring taskName;
+
+	/// <summary>How long the task waits after logon before it runs, as an ISO 8601 duration (e.g. "PT30S").</summary>
+	std::wstring taskDelay;
+};
+
+/// <summary>
+/// Gets the values that are used when there is no config snapshot.
+/// </summary>
+/// <returns>The default config.</returns>
+Config GetDefaultConfig();
+
+/// <summary>
+/// Parses a config file. Every line is either blank, a comment starting with '#', or a
+/// "key = value" pair. Any key that isn't given keeps its default value; the "target" key can be
+/// given more than once, and replaces the default targets when it is. A leading UTF-8 byte order
+/// mark is skipped.
+/// </summary>
+/// <param name="text">The contents of the config file, encoded as UTF-8.</param>
+/// <param name="config">Receives the config.</param>
+/// <param name="error">Receives a description of the problem if the config is invalid.</param>
+/// <returns><see langword="true" /> if it succeeds, else <see langword="false" />.</returns>
+bool ParseConfig(const std::string& text, Config& config, std::string& error);
+
+/// <summary>
+/// Compiles a config into a snapshot that can be loaded without any parsing.
+/// </summary>
+/// <param name="config">The config.</param>
+/// <returns>The snapshot.</returns>
+std::vector<unsigned char> CompileConfig(const Config& config);
+
+/// <summary>
+/// Loads a config from a snapshot created by <see cref="CompileConfig" />.
+/// </summary>
+/// <param name="data">The start of the snapshot.</param>
+/// <param name="size">The size of the snapshot.</param>
+/// <param name="config">Receives the config.</param>
+/// <returns><see langword="true" /> if it succeeds, else <see langword="false" /> (i.e. the snapshot is corrupt or from a different version).</returns>
+bool LoadConfigSnapshot(const void* data, std::size_t size, Config& config);
+
+/// <summary>
+/// Parses a config file and writes it out as a snapshot.
+/// </summary>
+/// <param name="inputPath">The path to the config file.</param>
+/// <param name="outputPath">The path to write the snapshot to.</param>
+/// <param name="error">Receives a description of the problem if it fails.</param>
+/// <returns><see langword="true" /> if it succeeds, else <see langword="false" />.</returns>
+bool CompileConfigFile(const std::wstring& inputPath, const std::wstring& outputPath, std::string& error);
+
+/// <summary>
+/// Memory-maps a snapshot and loads the config from it.
+/// </summary>
+/// <param name="path">The path to the snapshot.</param>
+/// <param name="config">Receives the config.</param>
+/// <returns><see langword="true" /> if it succeeds, else <see langword="false" />.</returns>
+bool LoadConfigSnapshotFile(const std::wstring& path, Config& config);
+
+#ifdef _WIN32
+
+/// <summary>
+/// Gets the path to the config snapshot, which lives next to this executable.
+/// </summary>
+/// <returns>The snapshot path or an empty string if it cannot be deduced.</returns>
+std::wstring GetConfigSnapshotPath();
+
+/// <summary>
+/// Gets the config for this deployment. The snapshot is only loaded the first time this is
+/// called; if there isn't one (or it can't be loaded), the defaults are used.
+/// </summary>
+/// <returns>The config.</returns>
+const Config& GetConfig();
+
+#endif
+
+#endif
@@ -7,11 +7,54 @@
 #include <Windows.h>
 
 #include "EventLog/TransitionFixerEventProvider.h"
+#include "journal.h"
+#include "mapped_file.h"
 #include "utils.h"
 
 namespace {
 	constexpr LPCWSTR APP_NAME = L"TransitionFixer";
 	constexpr LPCWSTR KEY_PATH = L"SYSTEM\\CurrentControlset\\Services\\EventLog\\Application\\TransitionFixer";
+	constexpr LPCWSTR JOURNAL_DIRECTORY = L"\\TransitionFixer";
+	constexpr LPCWSTR JOURNAL_FILE_NAME = L"\\journal.bin";
+	constexpr std::size_t JOURNAL_CAPACITY = 256 * 1024;
+
+	std::wstring GetJournalDirectory()
+	{
+		WCHAR localAppData[MAX_PATH];
+		DWORD length = GetEnvironmentVariableW(L"LOCALAPPDATA", localAppData, MAX_PATH);
+		if (length == 0 || length >= MAX_PATH) {
+			return std::wstring();
+		}
+
+		return std::wstring(localAppData, length) + JOURNAL_DIRECTORY;
+	}
+
+	bool OpenJournal(MappedFile& file, JournalWriter& writer)
+	{
+		std::wstring directory = GetJournalDirectory();
+		if (directory.empty()) {
+			return false;
+		}
+
+		if (!CreateDirectoryW(directory.c_str(), nullptr) && GetLastError() != ERROR_ALREADY_EXISTS) {
+			return false;
+		}
+
+		return file.Open(directory + JOURNAL_FILE_NAME, MappedFileAccess::ReadWrite, GetJournalSize(JOURNAL_CAPACITY))
+			&& writer.Attach(file.GetData(), file.GetSize());
+	}
+
+	void LogToJournal(JournalLevel level, const std::wstring& message)
+	{
+		// The journal is only mapped once per process. After that, appending to it is just a
+		// write to memory.
+		static MappedFile file;
+		static JournalWriter writer;
+		static bool opened = OpenJournal(file, writer);
+		if (opened) {
+			writer.Append(level, GetJournalTimestamp(), message);
+		}
+	}
 
 	bool LogMessage(WORD eventType, const std::wstring& message)
 	{
@@ -176,8 +219,10 @@ bool UninstallEventLogSource()
 
 void LogInfo(const std::wstring& message)
 {
-	if (IsEventLogSourceInstalled()) {
-		LogMessage(EVENTLOG_INFORMATION_TYPE, message);
+	// If we can't write to the event log, fall back to the local journal so that the message
+	// isn't lost when nobody is watching stderr (e.g. when we're run from the scheduled task).
+	if (!IsEventLogSourceInstalled() || !LogMessage(EVENTLOG_INFORMATION_TYPE, message)) {
+		LogToJournal(JournalLevel::Info, message);
 	}
 
 	std::wcerr << message << L"\n";
@@ -185,11 +230,49 @@ void LogInfo(const std::wstring& message)
 
 void LogError(const std::wstring& message)
 {
-	if (IsEventLogSourceInstalled()) {
-		LogMessage(EVENTLOG_ERROR_TYPE, message);
+	if (!IsEventLogSourceInstalled() || !LogMessage(EVENTLOG_ERROR_TYPE, message)) {
+		LogToJournal(JournalLevel::Error, message);
 	}
 
 	std::wcerr << message << L"\n";
 }
 
+std::wstring GetJournalPath()
+{
+	std::wstring directory = GetJournalDirectory();
+	if (directory.empty()) {
+		return std::wstring();
+	}
+
+	return directory + JOURNAL_FILE_NAME;
+}
+
+bool PrintJournal(const JournalFilter& filter)
+{
+	std::wstring path = GetJournalPath();
+	if (path.empty()) {
+		std::cerr << "Failed to locate journal: ";
+		std::wcerr << GetLastWin32Error();
+
+		return false;
+	}
 
+	MappedFile file;
+	if (!file.Open(path, MappedFileAccess::ReadOnly)) {
+		std::cerr << "Failed to open journal: ";
+		std::wcerr << GetLastWin32Error();
+
+		return false;
+	}
+
+	bool succeeded = ReadJournal(file.GetData(), file.GetSize(), filter, [](const JournalRecord& record) {
+		std::wcout << FormatJournalRecord(record) << L"\n";
+	});
+	if (!succeeded) {
+		std::cerr << "Failed to read journal: The file is not a journal, or is from a different version\n";
+		return false;
+	}
+
+	std::wcout.flush();
+	return true;
+}
@@ -3,6 +3,8 @@
 
 #include <string>
 
+#include "journal.h"
+
 /// <summary>
 /// Registers the event log source with the Windows Event Viewer
 /// </summary>
@@ -33,4 +35,18 @@ void LogInfo(const std::wstring& message);
 /// <param name="message">The message.</param>
 void LogError(const std::wstring& message);
 
+/// <summary>
+/// Gets the path to the local journal, which messages are written to when the event log source
+/// isn't installed.
+/// </summary>
+/// <returns>The journal path or an empty string if it cannot be deduced.</returns>
+std::wstring GetJournalPath();
+
+/// <summary>
+/// Prints the records in the local journal to stdout.
+/// </summary>
+/// <param name="filter">Which records to print.</param>
+/// <returns><see langword="true" /> if it succeeds, else <see langword="false" />.</returns>
+bool PrintJournal(const JournalFilter& filter);
+
 #endif
\ No newline at end of file
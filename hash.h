@@ -0,0 +1,64 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace Hash {
+	constexpr std::uint64_t FNV_OFFSET_BASIS = 0xCBF29CE484222325ULL;
+	constexpr std::uint64_t FNV_PRIME = 0x100000001B3ULL;
+
+	/// <summary>
+	/// Mixes a block of bytes into a running FNV-1a hash.
+	/// </summary>
+	/// <param name="hash">The running hash.</param>
+	/// <param name="data">The bytes to mix in.</param>
+	/// <param name="size">The number of bytes.</param>
+	/// <returns>The updated hash.</returns>
+	inline std::uint64_t Fnv1a(std::uint64_t hash, const void* data, std::size_t size)
+	{
+		const auto* bytes = static_cast<const unsigned char*>(data);
+		for (std::size_t i = 0; i < size; ++i) {
+			hash ^= bytes[i];
+			hash *= FNV_PRIME;
+		}
+
+		return hash;
+	}
+
+	/// <summary>
+	/// Mixes an integer into a running FNV-1a hash, independent of the host's byte order.
+	/// </summary>
+	/// <param name="hash">The running hash.</param>
+	/// <param name="value">The value to mix in.</param>
+	/// <returns>The updated hash.</returns>
+	inline std::uint64_t Fnv1a(std::uint64_t hash, std::uint32_t value)
+	{
+		for (int i = 0; i < 4; ++i) {
+			hash ^= static_cast<unsigned char>(value >> (i * 8));
+			hash *= FNV_PRIME;
+		}
+
+		return hash;
+	}
+
+	/// <summary>
+	/// Mixes a length-prefixed string into a running FNV-1a hash. Each character is hashed as a
+	/// 32-bit value so that the result is the same regardless of the size of wchar_t.
+	/// </summary>
+	/// <param name="hash">The running hash.</param>
+	/// <param name="value">The string to mix in.</param>
+	/// <returns>The updated hash.</returns>
+	inline std::uint64_t Fnv1a(std::uint64_t hash, const std::wstring& value)
+	{
+		hash = Fnv1a(hash, static_cast<std::uint32_t>(value.size()));
+		for (wchar_t ch : value) {
+			hash = Fnv1a(hash, static_cast<std::uint32_t>(ch));
+		}
+
+		return hash;
+	}
+}
+
+#endif
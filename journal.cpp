@@ -0,0 +1,377 @@
+#include "journal.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <ctime>
+#include <iomanip>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "hash.h"
+
+/// <summary>
+/// The header at the start of a journal. The records follow straight after it.
+/// </summary>
+struct JournalHeader {
+	std::atomic<std::uint32_t> magic;
+	std::uint32_t version;
+	std::uint64_t capacity;
+
+	/// <summary>The position the next record will be written at. Only ever grows.</summary>
+	std::atomic<std::uint64_t> head;
+
+	std::uint64_t reserved[5];
+};
+
+namespace {
+	constexpr std::uint32_t JOURNAL_MAGIC = 0x314A4654; // "TFJ1"
+	constexpr std::uint32_t JOURNAL_FORMATTING = 0x2A4A4654; // "TFJ*"
+	constexpr std::chrono::milliseconds FORMAT_TIMEOUT{ 100 };
+	constexpr std::uint32_t JOURNAL_VERSION = 1;
+	constexpr std::uint32_t RECORD_COMMITTED = 0x44434552; // "RECD"
+	constexpr std::uint32_t RECORD_PADDING = 0xFFFFFFFF;
+	constexpr std::uint64_t ALIGNMENT = 8;
+
+	/// <summary>
+	/// The header of a record. The message follows straight after it, as UTF-16 code units.
+	/// </summary>
+	struct RecordHeader {
+		std::atomic<std::uint32_t> state;
+		std::uint32_t size;
+		std::uint64_t position;
+		std::int64_t timestamp;
+		std::uint32_t level;
+		std::uint32_t length;
+		std::uint32_t checksum;
+		std::uint32_t reserved;
+	};
+
+	/// <summary>
+	/// A copy of a record, taken so that it can be verified without a writer changing it underneath us.
+	/// </summary>
+	struct RecordCopy {
+		std::uint32_t size = 0;
+		std::int64_t timestamp = 0;
+		std::uint32_t level = 0;
+		std::vector<std::uint16_t> chars;
+	};
+
+	static_assert(sizeof(JournalHeader) == 64, "The journal header must stay 64 bytes");
+	static_assert(sizeof(RecordHeader) == 40, "The record header must stay 40 bytes");
+	static_assert(std::atomic<std::uint64_t>::is_always_lock_free, "The journal needs lock-free atomics");
+
+	std::uint64_t AlignUp(std::uint64_t value)
+	{
+		return (value + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+	}
+
+	std::uint32_t ComputeChecksum(
+		std::uint64_t position,
+		std::int64_t timestamp,
+		std::uint32_t level,
+		const std::uint16_t* chars,
+		std::uint32_t length)
+	{
+		std::uint64_t hash = Hash::FNV_OFFSET_BASIS;
+		hash = Hash::Fnv1a(hash, &position, sizeof(position));
+		hash = Hash::Fnv1a(hash, &timestamp, sizeof(timestamp));
+		hash = Hash::Fnv1a(hash, level);
+		hash = Hash::Fnv1a(hash, chars, length * sizeof(std::uint16_t));
+
+		return static_cast<std::uint32_t>(hash ^ (hash >> 32));
+	}
+
+	std::uint16_t* GetChars(RecordHeader* record)
+	{
+		return reinterpret_cast<std::uint16_t*>(record + 1);
+	}
+
+	const std::uint16_t* GetChars(const RecordHeader* record)
+	{
+		return reinterpret_cast<const std::uint16_t*>(record + 1);
+	}
+
+	void WriteRecord(
+		RecordHeader* record,
+		std::uint64_t position,
+		std::uint64_t size,
+		std::uint32_t level,
+		std::int64_t timestamp,
+		const std::wstring& message,
+		std::uint32_t length)
+	{
+		// Mark the record as uncommitted first, so that readers don't trust it while we're
+		// still halfway through writing it (or if we crash halfway through).
+		record->state.store(0, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+
+		std::uint16_t* chars = GetChars(record);
+		for (std::uint32_t i = 0; i < length; ++i) {
+			// NOTE: wchar_t is UTF-16 on Windows already. Anywhere else, anything that doesn't
+			// fit into a single code unit is replaced.
+			chars[i] = static_cast<std::uint32_t>(message[i]) <= 0xFFFF
+				? static_cast<std::uint16_t>(message[i])
+				: static_cast<std::uint16_t>(L'?');
+		}
+
+		record->size = static_cast<std::uint32_t>(size);
+		record->position = position;
+		record->timestamp = timestamp;
+		record->level = level;
+		record->length = length;
+		record->checksum = ComputeChecksum(position, timestamp, level, chars, length);
+		record->reserved = 0;
+
+		record->state.store(RECORD_COMMITTED, std::memory_order_release);
+	}
+
+	bool TryCopyRecord(
+		const RecordHeader* record,
+		std::uint64_t position,
+		std::uint64_t remaining,
+		RecordCopy& copy)
+	{
+		if (record->state.load(std::memory_order_acquire) != RECORD_COMMITTED) {
+			return false;
+		}
+
+		// Copy everything first, and only then check it. A writer may start overwriting the record
+		// at any point, so anything read straight out of the journal can't be trusted until the
+		// state and position have been checked again afterwards (like a seqlock).
+		const std::uint32_t size = record->size;
+		const std::uint64_t recordPosition = record->position;
+		const std::uint32_t length = record->length;
+		const std::uint32_t checksum = record->checksum;
+		copy.timestamp = record->timestamp;
+		copy.level = record->level;
+		if (recordPosition != position
+			|| size < sizeof(RecordHeader)
+			|| size % ALIGNMENT != 0
+			|| size > remaining
+			|| sizeof(RecordHeader) + std::uint64_t{ length } * sizeof(std::uint16_t) > size) {
+			return false;
+		}
+
+		copy.size = size;
+		copy.chars.resize(length);
+		std::memcpy(copy.chars.data(), GetChars(record), length * sizeof(std::uint16_t));
+
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (record->state.load(std::memory_order_relaxed) != RECORD_COMMITTED
+			|| record->position != position) {
+			return false;
+		}
+
+		return checksum == ComputeChecksum(position, copy.timestamp, copy.level, copy.chars.data(), length);
+	}
+
+	const wchar_t* GetLevelName(JournalLevel level)
+	{
+		switch (level) {
+			case JournalLevel::Error:
+				return L"error";
+
+			case JournalLevel::Warning:
+				return L"warning";
+
+			case JournalLevel::Info:
+			default:
+				return L"info";
+		}
+	}
+
+	bool Matches(const JournalRecord& record, const JournalFilter& filter)
+	{
+		return filter.contains.empty()
+			|| record.message.find(filter.contains) != std::wstring::npos;
+	}
+}
+
+bool JournalWriter::Attach(void* data, std::size_t size)
+{
+	if (size < GetJournalSize(AlignUp(sizeof(RecordHeader)) * 2)) {
+		return false;
+	}
+
+	m_header = static_cast<JournalHeader*>(data);
+	m_records = static_cast<unsigned char*>(data) + sizeof(JournalHeader);
+	m_capacity = (size - sizeof(JournalHeader)) & ~(ALIGNMENT - 1);
+
+	// If this isn't a journal we understand (e.g. the file has just been created, or it was
+	// written by a different version), start over with an empty one. Whoever swaps the magic for
+	// JOURNAL_FORMATTING gets to do that, and everyone else waits until they're done, so that two
+	// processes opening a new journal at the same time don't wipe each other's records.
+	auto waitStart = std::chrono::steady_clock::now();
+	for (;;) {
+		std::uint32_t magic = m_header->magic.load(std::memory_order_acquire);
+		if (magic == JOURNAL_MAGIC
+			&& m_header->version == JOURNAL_VERSION
+			&& m_header->capacity == m_capacity) {
+			break;
+		}
+
+		if (magic == JOURNAL_FORMATTING) {
+			// Formatting only takes a moment, so if it's still going after the timeout, whoever
+			// was doing it has most likely died. Release their claim and try again.
+			if (std::chrono::steady_clock::now() - waitStart > FORMAT_TIMEOUT) {
+				m_header->magic.compare_exchange_strong(magic, 0, std::memory_order_acq_rel);
+				waitStart = std::chrono::steady_clock::now();
+			}
+
+			std::this_thread::yield();
+			continue;
+		}
+
+		if (m_header->magic.compare_exchange_strong(magic, JOURNAL_FORMATTING, std::memory_order_acq_rel)) {
+			std::memset(m_records, 0, static_cast<std::size_t>(m_capacity));
+			m_header->version = JOURNAL_VERSION;
+			m_header->capacity = m_capacity;
+			m_header->head.store(0, std::memory_order_relaxed);
+			std::memset(m_header->reserved, 0, sizeof(m_header->reserved));
+			m_header->magic.store(JOURNAL_MAGIC, std::memory_order_release);
+			break;
+		}
+	}
+
+	return true;
+}
+
+bool JournalWriter::Append(JournalLevel level, std::int64_t timestamp, const std::wstring& message)
+{
+	if (m_header == nullptr) {
+		return false;
+	}
+
+	const std::uint64_t maxLength = (m_capacity / 2 - sizeof(RecordHeader)) / sizeof(std::uint16_t);
+	const auto length = static_cast<std::uint32_t>(std::min<std::uint64_t>(message.size(), maxLength));
+	const std::uint64_t size = AlignUp(sizeof(RecordHeader) + length * sizeof(std::uint16_t));
+
+	for (;;) {
+		// Reserve space for the record. This is the only point where writers need to agree on
+		// anything, so a single atomic add is enough.
+		std::uint64_t position = m_header->head.fetch_add(size, std::memory_order_acq_rel);
+		std::uint64_t offset = position % m_capacity;
+		std::uint64_t remaining = m_capacity - offset;
+		if (remaining >= size) {
+			auto* record = reinterpret_cast<RecordHeader*>(m_records + offset);
+			WriteRecord(record, position, size, static_cast<std::uint32_t>(level), timestamp, message, length);
+			return true;
+		}
+
+		// The record would run off the end of the journal. Fill the rest of it with padding (if
+		// there's room for a header) and try again from the start.
+		if (remaining >= sizeof(RecordHeader)) {
+			auto* record = reinterpret_cast<RecordHeader*>(m_records + offset);
+			WriteRecord(record, position, remaining, RECORD_PADDING, 0, std::wstring(), 0);
+		}
+	}
+}
+
+std::size_t GetJournalSize(std::size_t capacity)
+{
+	return sizeof(JournalHeader) + static_cast<std::size_t>(AlignUp(capacity));
+}
+
+bool ReadJournal(
+	const void* data,
+	std::size_t size,
+	const JournalFilter& filter,
+	const std::function<void(const JournalRecord&)>& callback)
+{
+	if (data == nullptr || size < sizeof(JournalHeader)) {
+		return false;
+	}
+
+	const auto* header = static_cast<const JournalHeader*>(data);
+	const std::uint64_t capacity = header->capacity;
+	if (header->magic.load(std::memory_order_acquire) != JOURNAL_MAGIC
+		|| header->version != JOURNAL_VERSION
+		|| capacity == 0
+		|| capacity % ALIGNMENT != 0
+		|| capacity > size - sizeof(JournalHeader)) {
+		return false;
+	}
+
+	const unsigned char* records = static_cast<const unsigned char*>(data) + sizeof(JournalHeader);
+	const std::uint64_t head = header->head.load(std::memory_order_acquire);
+
+	// Anything older than one lap behind the head has been overwritten. Where that lands isn't
+	// necessarily the start of a record, so anything that doesn't check out is skipped over an
+	// alignment step at a time until we find one that does.
+	std::uint64_t position = head > capacity ? head - capacity : 0;
+	RecordCopy copy;
+	JournalRecord result;
+	while (position < head) {
+		std::uint64_t offset = position % capacity;
+		std::uint64_t remaining = capacity - offset;
+		if (remaining < sizeof(RecordHeader)) {
+			position += remaining;
+			continue;
+		}
+
+		const auto* record = reinterpret_cast<const RecordHeader*>(records + offset);
+		if (!TryCopyRecord(record, position, remaining, copy)) {
+			position += ALIGNMENT;
+			continue;
+		}
+
+		if (copy.level != RECORD_PADDING
+			&& copy.level >= static_cast<std::uint32_t>(filter.minLevel)
+			&& copy.timestamp >= filter.since) {
+			result.position = position;
+			result.timestamp = copy.timestamp;
+			result.level = static_cast<JournalLevel>(copy.level);
+			result.message.assign(copy.chars.begin(), copy.chars.end());
+			if (Matches(result, filter)) {
+				callback(result);
+			}
+		}
+
+		position += copy.size;
+	}
+
+	return true;
+}
+
+std::int64_t GetJournalTimestamp()
+{
+	auto now = std::chrono::system_clock::now().time_since_epoch();
+	return std::chrono::duration_cast<std::chrono::milliseconds>(now).count();
+}
+
+std::wstring FormatJournalRecord(const JournalRecord& record)
+{
+	std::time_t seconds = static_cast<std::time_t>(record.timestamp / 1000);
+	int milliseconds = static_cast<int>(record.timestamp % 1000);
+	std::tm timeUtc = *std::gmtime(&seconds);
+
+	std::wstringstream stream;
+	stream
+		<< std::put_time(&timeUtc, L"%FT%T")
+		<< L"." << std::setw(3) << std::setfill(L'0') << milliseconds << L"Z"
+		<< L" [" << GetLevelName(record.level) << L"] "
+		<< record.message;
+
+	return stream.str();
+}
+
+bool ParseJournalLevel(const std::string& name, JournalLevel& level)
+{
+	if (name == "info") {
+		level = JournalLevel::Info;
+	}
+	else if (name == "warning") {
+		level = JournalLevel::Warning;
+	}
+	else if (name == "error") {
+		level = JournalLevel::Error;
+	}
+	else {
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,124 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+/// <summary>
+/// The severity of a journal record.
+/// </summary>
+enum class JournalLevel : std::uint32_t {
+	Info = 0,
+	Warning = 1,
+	Error = 2,
+};
+
+/// <summary>
+/// A record that has been read back from the journal.
+/// </summary>
+struct JournalRecord {
+	/// <summary>Where the record was written, counted in bytes since the journal was created. This only ever grows.</summary>
+	std::uint64_t position = 0;
+
+	/// <summary>When the record was written, in milliseconds since the Unix epoch (UTC).</summary>
+	std::int64_t timestamp = 0;
+
+	JournalLevel level = JournalLevel::Info;
+	std::wstring message;
+};
+
+/// <summary>
+/// Which records <see cref="ReadJournal" /> should return.
+/// </summary>
+struct JournalFilter {
+	JournalLevel minLevel = JournalLevel::Info;
+	std::int64_t since = 0;
+	std::wstring contains;
+};
+
+struct JournalHeader;
+
+/// <summary>
+/// Appends records to a journal that lives in a fixed-size block of (usually memory-mapped)
+/// memory. Once the journal is full, the oldest records are overwritten.
+/// </summary>
+/// <remarks>
+/// Appending only touches the memory itself, so it never makes a syscall. Several writers (even
+/// in different processes) can share the same journal: space is reserved with an atomic add, and
+/// every record carries a checksum and is only marked as committed once it has been written, so
+/// records that were torn by a crash or overwritten mid-read are skipped by the reader.
+/// </remarks>
+class JournalWriter {
+public:
+	/// <summary>
+	/// Attaches the writer to a block of memory, formatting it as an empty journal if it doesn't
+	/// already contain one of the right size. Several writers can attach to the same block at once;
+	/// only one of them formats it.
+	/// </summary>
+	/// <param name="data">The start of the block. It must be 8-byte aligned.</param>
+	/// <param name="size">The size of the block.</param>
+	/// <returns><see langword="true" /> if it succeeds, else <see langword="false" /> (i.e. the block is too small).</returns>
+	bool Attach(void* data, std::size_t size);
+
+	/// <summary>
+	/// Appends a record to the journal. Messages that would take up more than half of the journal
+	/// are truncated.
+	/// </summary>
+	/// <param name="level">The severity of the record.</param>
+	/// <param name="timestamp">When the record was written, in milliseconds since the Unix epoch (UTC).</param>
+	/// <param name="message">The message.</param>
+	/// <returns><see langword="true" /> if it succeeds, else <see langword="false" /> (i.e. the writer isn't attached).</returns>
+	bool Append(JournalLevel level, std::int64_t timestamp, const std::wstring& message);
+
+private:
+	JournalHeader* m_header = nullptr;
+	unsigned char* m_records = nullptr;
+	std::uint64_t m_capacity = 0;
+};
+
+/// <summary>
+/// Gets the size of the block of memory a journal needs to hold the given number of bytes worth
+/// of records.
+/// </summary>
+/// <param name="capacity">The number of bytes worth of records.</param>
+/// <returns>The size of the block.</returns>
+std::size_t GetJournalSize(std::size_t capacity);
+
+/// <summary>
+/// Reads the records in a journal, from oldest to newest.
+/// </summary>
+/// <param name="data">The start of the journal.</param>
+/// <param name="size">The size of the journal.</param>
+/// <param name="filter">Which records to return.</param>
+/// <param name="callback">Called for every record that matches the filter.</param>
+/// <returns><see langword="true" /> if the block contains a journal, else <see langword="false" />.</returns>
+bool ReadJournal(
+	const void* data,
+	std::size_t size,
+	const JournalFilter& filter,
+	const std::function<void(const JournalRecord&)>& callback);
+
+/// <summary>
+/// Gets the current time as a journal timestamp.
+/// </summary>
+/// <returns>The number of milliseconds since the Unix epoch (UTC).</returns>
+std::int64_t GetJournalTimestamp();
+
+/// <summary>
+/// Formats a record as a single line of text, e.g. "2020-01-01T00:00:00.000Z [error] message".
+/// </summary>
+/// <param name="record">The record.</param>
+/// <returns>The formatted record.</returns>
+std::wstring FormatJournalRecord(const JournalRecord& record);
+
+/// <summary>
+/// Parses the name of a journal level (i.e. "info", "warning" or "error").
+/// </summary>
+/// <param name="name">The name.</param>
+/// <param name="level">Receives the level.</param>
+/// <returns><see langword="true" /> if the name is valid, else <see langword="false" />.</returns>
+bool ParseJournalLevel(const std::string& name, JournalLevel& level);
+
+#endif
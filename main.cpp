@@ -5,8 +5,10 @@
 
 #include "wil/result.h"
 
+#include "config.h"
 #include "exit_code.h"
 #include "event_log.h"
+#include "startup_stats.h"
 #include "task_scheduler.h"
 #include "transition_fixer.h"
 #include "utils.h"
@@ -15,9 +17,12 @@ namespace po = boost::program_options;
 
 int main(int argc, char* argv[])
 {
+	MarkMainEntered();
+
 	po::options_description opts("Allowed Options");
 	opts.add_options()
 		("help", "Show this help message")
+		("startup-stats", po::bool_switch(), "Print the startup cost of this run once it's done")
 #ifdef _DEBUG
 		("break", po::bool_switch(), "Break as soon as the program starts")
 #endif
@@ -30,11 +35,31 @@ int main(int argc, char* argv[])
 			"- install-event-log\n"
 			"- uninstall-event-log\n"
 			"- install-task\n"
-			"- uninstall-task");
+			"- uninstall-task\n"
+			"- read-journal\n"
+			"- compile-config")
+		("level",
+			po::value<std::string>()->default_value("info"),
+			"read-journal: Only show records at this level or higher (info, warning or error)")
+		("contains",
+			po::value<std::string>(),
+			"read-journal: Only show records whose message contains this text")
+		("since-minutes",
+			po::value<unsigned int>(),
+			"read-journal: Only show records written in the last N minutes")
+		("input",
+			po::value<std::string>(),
+			"compile-config: The config file to compile")
+		("output",
+			po::value<std::string>(),
+			"compile-config: Where to write the snapshot (defaults to next to this executable)");
 
 	po::positional_options_description pos;
 	pos.add("mode", 1);
 
+	// Declared outside of the try block so that the stats are still printed if a mode throws.
+	StartupStatsScope startupStats;
+
 	try {
 		po::variables_map vm;
 		po::store(
@@ -61,6 +86,10 @@ int main(int argc, char* argv[])
 		// What are we trying to do?
 		bool succeeded = false;
 		std::string mode = vm["mode"].as<std::string>();
+		if (vm["startup-stats"].as<bool>()) {
+			startupStats.Enable(mode);
+		}
+
 		if (mode == "install-event-log") {
 			succeeded = InstallEventLogSource();
 			if (succeeded) {
@@ -68,10 +97,16 @@ int main(int argc, char* argv[])
 			}
 		}
 		else if (mode == "install-task") {
-			succeeded = InstallTask();
-			if (succeeded) {
+			// NOTE: Failing to install the task throws, so if we get here, we succeeded.
+			TaskInstallResult result = InstallTask();
+			if (result == TaskInstallResult::UpToDate) {
+				LogInfo(L"Task in Windows Task Scheduler is already up to date, skipped installing it");
+			}
+			else {
 				LogInfo(L"Successfully installed task into Windows Task Scheduler");
 			}
+
+			succeeded = true;
 		}
 		else if (mode == "run") {
 			succeeded = ApplyFadeFix();
@@ -79,6 +114,52 @@ int main(int argc, char* argv[])
 				LogInfo(L"Successfully enabled Active Desktop");
 			}
 		}
+		else if (mode == "compile-config") {
+			if (!vm.count("input")) {
+				std::cerr
+					<< "Error: compile-config requires --input\n"
+					<< opts
+					<< std::endl;
+
+				return ExitCode::ERR_CMDLINE_ERROR;
+			}
+
+			std::wstring input = ToWideString(vm["input"].as<std::string>());
+			std::wstring output = vm.count("output")
+				? ToWideString(vm["output"].as<std::string>())
+				: GetConfigSnapshotPath();
+
+			std::string error;
+			succeeded = CompileConfigFile(input, output, error);
+			if (succeeded) {
+				LogInfo(L"Successfully compiled config snapshot to " + output);
+			}
+			else {
+				std::cerr << "Failed to compile config: " << error << "\n";
+			}
+		}
+		else if (mode == "read-journal") {
+			JournalFilter filter;
+			if (!ParseJournalLevel(vm["level"].as<std::string>(), filter.minLevel)) {
+				std::cerr
+					<< "Error: Unrecognized level '" << vm["level"].as<std::string>() << "'\n"
+					<< opts
+					<< std::endl;
+
+				return ExitCode::ERR_CMDLINE_ERROR;
+			}
+
+			if (vm.count("contains")) {
+				filter.contains = ToWideString(vm["contains"].as<std::string>());
+			}
+
+			if (vm.count("since-minutes")) {
+				std::int64_t minutes = vm["since-minutes"].as<unsigned int>();
+				filter.since = GetJournalTimestamp() - minutes * 60 * 1000;
+			}
+
+			succeeded = PrintJournal(filter);
+		}
 		else if (mode == "uninstall-event-log") {
 			succeeded = UninstallEventLogSource();
 			if (succeeded) {
@@ -108,7 +189,9 @@ int main(int argc, char* argv[])
 		}
 	}
 	catch (const wil::ResultException& ex) {
-		std::cerr << ex.what() << std::endl;
+		// Log it rather than just printing it, as nobody sees stderr when we're run from the
+		// scheduled task.
+		LogError(ToWideString(ex.what()));
 
 		return ExitCode::ERR_FAILURE;
 	}
@@ -120,4 +203,10 @@ int main(int argc, char* argv[])
 
 		return ExitCode::ERR_CMDLINE_ERROR;
 	}
+	catch (const std::exception& ex) {
+		// Anything else (e.g. from the standard library) is still a failure rather than a crash.
+		LogError(ToWideString(ex.what()));
+
+		return ExitCode::ERR_FAILURE;
+	}
 }
\ No newline at end of file
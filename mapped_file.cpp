@@ -0,0 +1,157 @@
+#include "mapped_file.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <filesystem>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::Open(const std::wstring& path, MappedFileAccess access, std::size_t size)
+{
+	Close();
+
+	bool writable = access == MappedFileAccess::ReadWrite;
+	HANDLE file = CreateFileW(
+		path.c_str(),
+		writable ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ,
+		FILE_SHARE_READ | FILE_SHARE_WRITE,
+		nullptr,
+		writable ? OPEN_ALWAYS : OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL,
+		nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+
+	if (!writable) {
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+			CloseHandle(file);
+			return false;
+		}
+
+		size = static_cast<std::size_t>(fileSize.QuadPart);
+	}
+
+	// NOTE: When mapping for writing, CreateFileMapping grows the file to the requested size
+	// if it's smaller than that.
+	ULARGE_INTEGER mappingSize;
+	mappingSize.QuadPart = size;
+	HANDLE mapping = CreateFileMappingW(
+		file,
+		nullptr,
+		writable ? PAGE_READWRITE : PAGE_READONLY,
+		mappingSize.HighPart,
+		mappingSize.LowPart,
+		nullptr);
+	if (mapping == nullptr) {
+		CloseHandle(file);
+		return false;
+	}
+
+	void* data = MapViewOfFile(mapping, writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, size);
+	if (data == nullptr) {
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+
+	m_file = file;
+	m_mapping = mapping;
+	m_data = data;
+	m_size = size;
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (m_data != nullptr) {
+		UnmapViewOfFile(m_data);
+		m_data = nullptr;
+	}
+
+	if (m_mapping != nullptr) {
+		CloseHandle(m_mapping);
+		m_mapping = nullptr;
+	}
+
+	if (m_file != nullptr) {
+		CloseHandle(m_file);
+		m_file = nullptr;
+	}
+
+	m_size = 0;
+}
+
+#else
+
+bool MappedFile::Open(const std::wstring& path, MappedFileAccess access, std::size_t size)
+{
+	Close();
+
+	bool writable = access == MappedFileAccess::ReadWrite;
+	std::filesystem::path filePath(path);
+	int file = open(filePath.c_str(), writable ? O_RDWR | O_CREAT : O_RDONLY, 0644);
+	if (file < 0) {
+		return false;
+	}
+
+	struct stat fileStat;
+	if (fstat(file, &fileStat) != 0) {
+		close(file);
+		return false;
+	}
+
+	if (!writable) {
+		size = static_cast<std::size_t>(fileStat.st_size);
+	}
+	else if (static_cast<std::size_t>(fileStat.st_size) < size && ftruncate(file, static_cast<off_t>(size)) != 0) {
+		close(file);
+		return false;
+	}
+
+	if (size == 0) {
+		close(file);
+		return false;
+	}
+
+	void* data = mmap(nullptr, size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, file, 0);
+	if (data == MAP_FAILED) {
+		close(file);
+		return false;
+	}
+
+	m_file = file;
+	m_data = data;
+	m_size = size;
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (m_data != nullptr) {
+		munmap(m_data, m_size);
+		m_data = nullptr;
+	}
+
+	if (m_file >= 0) {
+		close(m_file);
+		m_file = -1;
+	}
+
+	m_size = 0;
+}
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+
+/// <summary>
+/// How a <see cref="MappedFile" /> is opened.
+/// </summary>
+enum class MappedFileAccess {
+	/// <summary>Maps the whole of an existing file for reading.</summary>
+	ReadOnly,
+
+	/// <summary>Maps the file for reading and writing, creating it (or growing it) to the requested size.</summary>
+	ReadWrite,
+};
+
+/// <summary>
+/// A file that is mapped into memory. The mapping is shared, so writes are visible to every other
+/// process that maps the same file.
+/// </summary>
+class MappedFile {
+public:
+	MappedFile() = default;
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	/// <summary>
+	/// Opens and maps the file, closing whatever was mapped before.
+	/// </summary>
+	/// <param name="path">The path to the file.</param>
+	/// <param name="access">How to open the file.</param>
+	/// <param name="size">The size to map the file as. Only used with <see cref="MappedFileAccess::ReadWrite" />.</param>
+	/// <returns><see langword="true" /> if it succeeds, else <see langword="false" />.</returns>
+	bool Open(const std::wstring& path, MappedFileAccess access, std::size_t size = 0);
+
+	/// <summary>
+	/// Unmaps and closes the file.
+	/// </summary>
+	void Close();
+
+	/// <summary>
+	/// Gets the start of the mapping, or <see langword="nullptr" /> if nothing is mapped.
+	/// </summary>
+	void* GetData() const
+	{
+		return m_data;
+	}
+
+	/// <summary>
+	/// Gets the size of the mapping.
+	/// </summary>
+	std::size_t GetSize() const
+	{
+		return m_size;
+	}
+
+private:
+	void* m_data = nullptr;
+	std::size_t m_size = 0;
+#ifdef _WIN32
+	void* m_file = nullptr;
+	void* m_mapping = nullptr;
+#else
+	int m_file = -1;
+#endif
+};
+
+#endif
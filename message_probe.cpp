@@ -0,0 +1,120 @@
+#include "message_probe.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+#include "hash.h"
+
+namespace {
+	constexpr std::uint32_t WM_USER_BASE = 0x0400;
+	constexpr std::uint32_t WM_ENABLE_ACTIVEDESKTOP = WM_USER_BASE + 0x12C;
+
+	SendResult TrySend(MessageSender& sender, const MessageVariant& variant, ProbeResult& result)
+	{
+		++result.attempts;
+		return sender.Send(variant);
+	}
+}
+
+std::vector<MessageVariant> GetKnownMessageVariants(const std::vector<std::wstring>& windowClasses)
+{
+	// For each window class, the first variant is the one that has always been sent. The others
+	// are what later builds of Explorer (and some shell replacements) respond to instead.
+	std::vector<MessageVariant> variants;
+	for (const auto& windowClass : windowClasses) {
+		variants.push_back({ windowClass, WM_ENABLE_ACTIVEDESKTOP, 0x0, 0 });
+		variants.push_back({ windowClass, WM_ENABLE_ACTIVEDESKTOP, 0xD, 0 });
+		variants.push_back({ windowClass, WM_ENABLE_ACTIVEDESKTOP, 0xD, 1 });
+	}
+
+	return variants;
+}
+
+std::wstring MakeProbeCacheKey(
+	const std::wstring& osBuild,
+	const std::wstring& shell,
+	const std::vector<MessageVariant>& variants)
+{
+	std::uint64_t hash = Hash::FNV_OFFSET_BASIS;
+	for (const auto& variant : variants) {
+		hash = Hash::Fnv1a(hash, variant.windowClass);
+		hash = Hash::Fnv1a(hash, variant.message);
+		hash = Hash::Fnv1a(hash, static_cast<std::uint32_t>(variant.wParam));
+		hash = Hash::Fnv1a(hash, static_cast<std::uint32_t>(variant.lParam));
+	}
+
+	std::wstringstream key;
+	key << osBuild << L"|" << shell << L"|"
+		<< std::hex << std::setw(16) << std::setfill(L'0') << hash;
+
+	return key.str();
+}
+
+ProbeResult ProbeAndSend(
+	MessageSender& sender,
+	ProbeCache& cache,
+	const std::wstring& key,
+	const std::vector<MessageVariant>& variants)
+{
+	ProbeResult result;
+
+	// If we've probed before, start with the variant that worked last time.
+	std::vector<std::size_t> order;
+	std::uint32_t cachedIndex = 0;
+	bool hasCachedIndex = cache.TryGet(key, cachedIndex) && cachedIndex < variants.size();
+	if (hasCachedIndex) {
+		order.push_back(cachedIndex);
+	}
+
+	for (std::size_t i = 0; i < variants.size(); ++i) {
+		if (!hasCachedIndex || i != cachedIndex) {
+			order.push_back(i);
+		}
+	}
+
+	std::vector<std::wstring> missingClasses;
+	for (std::size_t index : order) {
+		const MessageVariant& variant = variants[index];
+		if (std::find(missingClasses.begin(), missingClasses.end(), variant.windowClass) != missingClasses.end()) {
+			continue;
+		}
+
+		SendResult sendResult = TrySend(sender, variant, result);
+		switch (sendResult) {
+			case SendResult::WindowNotFound:
+				// Try the next window class instead (e.g. a shell replacement that has no Progman).
+				missingClasses.push_back(variant.windowClass);
+				continue;
+
+			case SendResult::NotResponding:
+				// The window is hung, so the other variants won't fare any better. Leave the cache
+				// alone, since this says nothing about which variant works.
+				result.windowFound = true;
+				result.notResponding = true;
+				return result;
+
+			case SendResult::NoEffect:
+				result.windowFound = true;
+				continue;
+
+			case SendResult::Unconfirmed:
+			case SendResult::Applied:
+				break;
+		}
+
+		bool isCached = hasCachedIndex && index == cachedIndex;
+		result.succeeded = true;
+		result.confirmed = sendResult == SendResult::Applied;
+		result.windowFound = true;
+		result.fromCache = isCached;
+		result.variantIndex = index;
+		if (result.confirmed && !isCached) {
+			cache.Set(key, static_cast<std::uint32_t>(index));
+		}
+
+		return result;
+	}
+
+	return result;
+}
@@ -0,0 +1,140 @@
+#ifndef MESSAGE_PROBE_H
+#define MESSAGE_PROBE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/// <summary>
+/// A window message, along with the window it needs to be sent to.
+/// </summary>
+struct MessageVariant {
+	std::wstring windowClass;
+	std::uint32_t message = 0;
+	std::uintptr_t wParam = 0;
+	std::intptr_t lParam = 0;
+};
+
+/// <summary>
+/// The outcome of sending a <see cref="MessageVariant" />.
+/// </summary>
+enum class SendResult {
+	/// <summary>There is no window of the variant's class (e.g. a shell replacement is running).</summary>
+	WindowNotFound,
+
+	/// <summary>The window exists, but the message couldn't be delivered (e.g. it timed out).</summary>
+	NotResponding,
+
+	/// <summary>The message was delivered, but Active Desktop still isn't enabled.</summary>
+	NoEffect,
+
+	/// <summary>The message was delivered, but whether it had an effect can't be told (e.g. the desktop's windows are laid out in a way we don't recognize).</summary>
+	Unconfirmed,
+
+	/// <summary>The message was delivered and Active Desktop is now enabled.</summary>
+	Applied,
+};
+
+/// <summary>
+/// Sends a <see cref="MessageVariant" /> to its window.
+/// </summary>
+class MessageSender {
+public:
+	virtual ~MessageSender() = default;
+
+	/// <summary>
+	/// Sends the message, then checks whether it had the desired effect.
+	/// </summary>
+	/// <param name="variant">The message to send.</param>
+	/// <returns>Whether the message was delivered, and if so, whether it had an effect.</returns>
+	virtual SendResult Send(const MessageVariant& variant) = 0;
+};
+
+/// <summary>
+/// Remembers which variant worked last time, so later runs don't need to probe again.
+/// </summary>
+class ProbeCache {
+public:
+	virtual ~ProbeCache() = default;
+
+	/// <summary>
+	/// Looks up the variant that worked for the given key.
+	/// </summary>
+	/// <param name="key">The cache key.</param>
+	/// <param name="index">Receives the index of the variant that worked.</param>
+	/// <returns><see langword="true" /> if there is an entry for the key, else <see langword="false" />.</returns>
+	virtual bool TryGet(const std::wstring& key, std::uint32_t& index) = 0;
+
+	/// <summary>
+	/// Records the variant that had an effect for the given key.
+	/// </summary>
+	/// <param name="key">The cache key.</param>
+	/// <param name="index">The index of the variant that worked.</param>
+	virtual void Set(const std::wstring& key, std::uint32_t index) = 0;
+};
+
+/// <summary>
+/// The outcome of <see cref="ProbeAndSend" />.
+/// </summary>
+struct ProbeResult {
+	bool succeeded = false;
+
+	/// <summary>Whether the effect of the variant that succeeded was confirmed. Unconfirmed variants aren't cached.</summary>
+	bool confirmed = false;
+
+	/// <summary>Whether a window of any of the variants' classes was found.</summary>
+	bool windowFound = false;
+
+	/// <summary>Whether the probe was cut short because a window stopped responding.</summary>
+	bool notResponding = false;
+
+	bool fromCache = false;
+	std::size_t variantIndex = 0;
+	std::size_t attempts = 0;
+};
+
+/// <summary>
+/// Gets the variants of the "enable Active Desktop" message that are known to work, in the order
+/// they should be tried.
+/// </summary>
+/// <param name="windowClasses">The window classes to send the message to, in the order they should be tried.</param>
+/// <returns>The known variants.</returns>
+std::vector<MessageVariant> GetKnownMessageVariants(const std::vector<std::wstring>& windowClasses);
+
+/// <summary>
+/// Builds the key that a probe result is cached under. The key covers the variants themselves,
+/// so that a cached index is never applied to a different list of variants.
+/// </summary>
+/// <param name="osBuild">The build number of the OS.</param>
+/// <param name="shell">The shell that is running.</param>
+/// <param name="variants">The variants that are being probed.</param>
+/// <returns>The cache key.</returns>
+std::wstring MakeProbeCacheKey(
+	const std::wstring& osBuild,
+	const std::wstring& shell,
+	const std::vector<MessageVariant>& variants);
+
+/// <summary>
+/// Sends variants until one of them has an effect. The cached variant is tried first, followed by
+/// the rest in order. A variant is only cached once it has been seen to have an effect.
+/// </summary>
+/// <remarks>
+/// If a window doesn't exist, the rest of the variants for its class are skipped, and the probe
+/// moves on to the next class. If a window exists but doesn't respond, the probe stops without
+/// touching the cache, since trying other variants then would only cost more timeouts. If the
+/// effect of a variant can't be confirmed either way, it's treated as a success, the same as
+/// before the effect was checked, but isn't cached.
+/// </remarks>
+/// <param name="sender">The message sender.</param>
+/// <param name="cache">The probe cache.</param>
+/// <param name="key">The cache key, see <see cref="MakeProbeCacheKey" />.</param>
+/// <param name="variants">The variants to try.</param>
+/// <returns>The outcome of the probe.</returns>
+ProbeResult ProbeAndSend(
+	MessageSender& sender,
+	ProbeCache& cache,
+	const std::wstring& key,
+	const std::vector<MessageVariant>& variants);
+
+#endif
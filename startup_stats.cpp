@@ -0,0 +1,120 @@
+#include "startup_stats.h"
+
+#include <iomanip>
+#include <iostream>
+
+#include <Windows.h>
+#include <Psapi.h>
+
+namespace {
+	using GetSystemTimePreciseAsFileTimeFunc = VOID(WINAPI*)(LPFILETIME);
+
+	ULONGLONG g_mainEnteredAt = 0;
+
+	ULONGLONG ToTicks(const FILETIME& fileTime)
+	{
+		ULARGE_INTEGER value;
+		value.LowPart = fileTime.dwLowDateTime;
+		value.HighPart = fileTime.dwHighDateTime;
+
+		return value.QuadPart;
+	}
+
+	ULONGLONG GetCurrentTicks()
+	{
+		// NOTE: GetSystemTimePreciseAsFileTime only exists on Windows 8 and higher, and
+		// GetSystemTimeAsFileTime is too coarse to be useful, so prefer the former if we can.
+		static const auto getPreciseTime = reinterpret_cast<GetSystemTimePreciseAsFileTimeFunc>(
+			GetProcAddress(GetModuleHandleW(L"kernel32.dll"), "GetSystemTimePreciseAsFileTime"));
+
+		FILETIME now;
+		if (getPreciseTime != nullptr) {
+			getPreciseTime(&now);
+		}
+		else {
+			GetSystemTimeAsFileTime(&now);
+		}
+
+		return ToTicks(now);
+	}
+
+	ULONGLONG GetProcessCreationTicks()
+	{
+		FILETIME creationTime, exitTime, kernelTime, userTime;
+		if (!GetProcessTimes(GetCurrentProcess(), &creationTime, &exitTime, &kernelTime, &userTime)) {
+			return 0;
+		}
+
+		return ToTicks(creationTime);
+	}
+
+	ULONGLONG GetElapsedTicks(ULONGLONG from, ULONGLONG to)
+	{
+		// NOTE: The creation time comes from a different clock than GetCurrentTicks(), and on
+		// Windows 7 the latter is only updated every 10-16ms, so "to" can come out earlier than
+		// "from". Clamp that to zero instead of letting the subtraction wrap around.
+		return to > from ? to - from : 0;
+	}
+
+	double TicksToMilliseconds(ULONGLONG ticks)
+	{
+		// A FILETIME tick is 100ns.
+		return static_cast<double>(ticks) / 10000.0;
+	}
+
+	DWORD GetLoadedModuleCount()
+	{
+		HMODULE modules[1];
+		DWORD bytesNeeded = 0;
+		if (!EnumProcessModules(GetCurrentProcess(), modules, sizeof(modules), &bytesNeeded)) {
+			return 0;
+		}
+
+		return bytesNeeded / sizeof(HMODULE);
+	}
+
+	DWORD GetPageFaultCount()
+	{
+		PROCESS_MEMORY_COUNTERS counters = { 0 };
+		counters.cb = sizeof(counters);
+		if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+			return 0;
+		}
+
+		return counters.PageFaultCount;
+	}
+}
+
+void MarkMainEntered()
+{
+	g_mainEnteredAt = GetCurrentTicks();
+}
+
+void PrintStartupStats(const std::string& mode)
+{
+	ULONGLONG createdAt = GetProcessCreationTicks();
+	ULONGLONG now = GetCurrentTicks();
+
+	std::cerr
+		<< "startup-stats"
+		<< " mode=" << mode
+		<< " modules=" << GetLoadedModuleCount()
+		<< " page-faults=" << GetPageFaultCount()
+		<< std::fixed << std::setprecision(3)
+		<< " time-to-main-ms=" << TicksToMilliseconds(GetElapsedTicks(createdAt, g_mainEnteredAt))
+		<< " total-ms=" << TicksToMilliseconds(GetElapsedTicks(createdAt, now))
+		<< std::endl;
+}
+
+StartupStatsScope::~StartupStatsScope()
+{
+	if (m_enabled) {
+		PrintStartupStats(m_mode);
+	}
+}
+
+void StartupStatsScope::Enable(const std::string& mode)
+{
+	m_enabled = true;
+	m_mode = mode;
+}
@@ -0,0 +1,42 @@
+#ifndef STARTUP_STATS_H
+#define STARTUP_STATS_H
+
+#include <string>
+
+/// <summary>
+/// Records how long it took the process to reach main(). This should be called as early as
+/// possible in main().
+/// </summary>
+void MarkMainEntered();
+
+/// <summary>
+/// Writes the startup cost of this process (modules loaded, page faults, time to main() and total
+/// time so far) to stderr as a single line, so that it can be picked up by the startup benchmark.
+/// </summary>
+/// <param name="mode">The mode the program ran as.</param>
+void PrintStartupStats(const std::string& mode);
+
+/// <summary>
+/// Calls <see cref="PrintStartupStats" /> when it goes out of scope, once it has been enabled. This
+/// makes sure the stats are printed however main() returns, including when a mode fails or throws.
+/// </summary>
+class StartupStatsScope {
+public:
+	StartupStatsScope() = default;
+	StartupStatsScope(const StartupStatsScope&) = delete;
+	StartupStatsScope& operator=(const StartupStatsScope&) = delete;
+
+	~StartupStatsScope();
+
+	/// <summary>
+	/// Enables printing the stats when this goes out of scope.
+	/// </summary>
+	/// <param name="mode">The mode the program is running as.</param>
+	void Enable(const std::string& mode);
+
+private:
+	bool m_enabled = false;
+	std::string m_mode;
+};
+
+#endif
@@ -0,0 +1,77 @@
+#include "task_definition.h"
+
+#include <cwctype>
+
+#include "hash.h"
+
+namespace {
+	std::wstring ToUpper(const std::wstring& value)
+	{
+		std::wstring upper = value;
+		for (auto& ch : upper) {
+			ch = static_cast<wchar_t>(std::towupper(static_cast<std::wint_t>(ch)));
+		}
+
+		return upper;
+	}
+}
+
+std::wstring NormalizeUserID(const std::wstring& userID)
+{
+	return ToUpper(userID);
+}
+
+bool IsSameTaskName(const std::wstring& first, const std::wstring& second)
+{
+	return ToUpper(first) == ToUpper(second);
+}
+
+std::uint64_t HashTaskSpec(const TaskSpec& spec)
+{
+	// NOTE: The order of the fields is part of the hash, so only ever append to this list.
+	std::uint64_t hash = Hash::FNV_OFFSET_BASIS;
+	hash = Hash::Fnv1a(hash, spec.author);
+	hash = Hash::Fnv1a(hash, spec.description);
+	hash = Hash::Fnv1a(hash, spec.version);
+	hash = Hash::Fnv1a(hash, static_cast<std::uint32_t>(spec.startWhenAvailable ? 1 : 0));
+	hash = Hash::Fnv1a(hash, NormalizeUserID(spec.userID));
+	hash = Hash::Fnv1a(hash, spec.delay);
+	hash = Hash::Fnv1a(hash, spec.path);
+	hash = Hash::Fnv1a(hash, spec.workingDirectory);
+	hash = Hash::Fnv1a(hash, spec.arguments);
+	hash = Hash::Fnv1a(hash, static_cast<std::uint32_t>(spec.enabled ? 1 : 0));
+	hash = Hash::Fnv1a(hash, NormalizeUserID(spec.principalUserID));
+	hash = Hash::Fnv1a(hash, spec.logonType);
+
+	return hash;
+}
+
+TaskInstallResult InstallTaskSpec(TaskStore& store, const std::wstring& name, const TaskSpec& spec, const std::wstring& installedName)
+{
+	// If the registered task already matches, don't bother rewriting it. This keeps reruns of
+	// install-task read-only.
+	TaskInstallResult result = TaskInstallResult::UpToDate;
+	TaskSpec registered;
+	if (!store.TryGetTask(name, registered) || HashTaskSpec(registered) != HashTaskSpec(spec)) {
+		store.SaveTask(name, spec);
+		result = TaskInstallResult::Saved;
+	}
+
+	// Otherwise, the task would keep running under its old name as well. It's only removed once
+	// the new one is saved, so that a failure doesn't leave no task at all.
+	if (!installedName.empty() && !IsSameTaskName(installedName, name)) {
+		store.DeleteTask(installedName);
+	}
+
+	return result;
+}
+
+bool UninstallTaskSpec(TaskStore& store, const std::wstring& name, const std::wstring& installedName)
+{
+	bool deleted = store.DeleteTask(name);
+	if (!installedName.empty() && !IsSameTaskName(installedName, name)) {
+		deleted = store.DeleteTask(installedName) || deleted;
+	}
+
+	return deleted;
+}
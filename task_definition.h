@@ -0,0 +1,120 @@
+#ifndef TASK_DEFINITION_H
+#define TASK_DEFINITION_H
+
+#include <cstdint>
+#include <string>
+
+/// <summary>
+/// The fields of the scheduled task that we care about. Anything that is stamped at
+/// registration time (e.g. the registration date) is deliberately left out, so that two
+/// definitions describing the same task compare equal.
+/// </summary>
+struct TaskSpec {
+	std::wstring author;
+	std::wstring description;
+	std::wstring version;
+	bool startWhenAvailable = false;
+	bool enabled = false;
+	/// <summary>The account the task runs as, as DOMAIN\user.</summary>
+	std::wstring principalUserID;
+
+	/// <summary>The TASK_LOGON_TYPE the task runs with.</summary>
+	std::uint32_t logonType = 0;
+
+	/// <summary>The account whose logon triggers the task, as DOMAIN\user.</summary>
+	std::wstring userID;
+
+	std::wstring delay;
+	std::wstring path;
+	std::wstring workingDirectory;
+	std::wstring arguments;
+};
+
+/// <summary>
+/// A place where tasks can be read from and registered to.
+/// </summary>
+class TaskStore {
+public:
+	virtual ~TaskStore() = default;
+
+	/// <summary>
+	/// Reads the task that is currently registered under the given name. Accounts must be
+	/// returned as DOMAIN\user, even if the store keeps them as SIDs.
+	/// </summary>
+	/// <param name="name">The name of the task.</param>
+	/// <param name="spec">Receives the registered task, if it could be read.</param>
+	/// <returns><see langword="true" /> if the task exists and could be read, else <see langword="false" />.</returns>
+	virtual bool TryGetTask(const std::wstring& name, TaskSpec& spec) = 0;
+
+	/// <summary>
+	/// Registers the task under the given name, replacing whatever was there before.
+	/// </summary>
+	/// <param name="name">The name of the task.</param>
+	/// <param name="spec">The task to register.</param>
+	virtual void SaveTask(const std::wstring& name, const TaskSpec& spec) = 0;
+
+	/// <summary>
+	/// Removes the task that is registered under the given name.
+	/// </summary>
+	/// <param name="name">The name of the task.</param>
+	/// <returns><see langword="true" /> if the task was removed, else <see langword="false" /> (e.g. it doesn't exist).</returns>
+	virtual bool DeleteTask(const std::wstring& name) = 0;
+};
+
+/// <summary>
+/// The outcome of <see cref="InstallTaskSpec" />.
+/// </summary>
+enum class TaskInstallResult {
+	Saved,
+	UpToDate,
+};
+
+/// <summary>
+/// Normalizes an account name so that names that refer to the same account compare equal.
+/// Account names are case-insensitive, but the Task Scheduler doesn't necessarily hand them back
+/// in the case they were registered with.
+/// </summary>
+/// <param name="userID">The account name, as DOMAIN\user.</param>
+/// <returns>The normalized account name.</returns>
+std::wstring NormalizeUserID(const std::wstring& userID);
+
+/// <summary>
+/// Checks whether two task names refer to the same task. Like account names, task names are
+/// case-insensitive.
+/// </summary>
+/// <param name="first">The first task name.</param>
+/// <param name="second">The second task name.</param>
+/// <returns><see langword="true" /> if they refer to the same task, else <see langword="false" />.</returns>
+bool IsSameTaskName(const std::wstring& first, const std::wstring& second);
+
+/// <summary>
+/// Computes a canonical hash of a task, covering every field of <see cref="TaskSpec" />. Account
+/// names are hashed in their normalized form, see <see cref="NormalizeUserID" />.
+/// </summary>
+/// <param name="spec">The task.</param>
+/// <returns>The hash.</returns>
+std::uint64_t HashTaskSpec(const TaskSpec& spec);
+
+/// <summary>
+/// Registers the task with the store, unless the task that is already registered is the same.
+/// If the task was previously installed under a different name (i.e. the configured task name
+/// has changed since), the task under the old name is removed once the new one is in place.
+/// </summary>
+/// <param name="store">The task store.</param>
+/// <param name="name">The name of the task.</param>
+/// <param name="spec">The task to register.</param>
+/// <param name="installedName">The name the task was last installed under, or an empty string if it isn't known.</param>
+/// <returns>Whether the task was saved or was already up to date.</returns>
+TaskInstallResult InstallTaskSpec(TaskStore& store, const std::wstring& name, const TaskSpec& spec, const std::wstring& installedName = std::wstring());
+
+/// <summary>
+/// Removes the task from the store, both under its current name and under the name it was last
+/// installed under.
+/// </summary>
+/// <param name="store">The task store.</param>
+/// <param name="name">The name of the task.</param>
+/// <param name="installedName">The name the task was last installed under, or an empty string if it isn't known.</param>
+/// <returns><see langword="true" /> if a task was removed, else <see langword="false" />.</returns>
+bool UninstallTaskSpec(TaskStore& store, const std::wstring& name, const std::wstring& installedName = std::wstring());
+
+#endif
@@ -1,4 +1,6 @@
 #include "task_scheduler.h"
+#include "config.h"
+#include "task_definition.h"
 #include "utils.h"
 
 #include <iomanip>
@@ -9,6 +11,7 @@
 #include <atlcomcli.h>
 #include <comdef.h>
 #include <lmcons.h>
+#include <sddl.h>
 #include <security.h>
 #include <taskschd.h>
 #include <Windows.h>
@@ -18,6 +21,32 @@
 #include "wil/stl.h"
 
 namespace {
+    // The name the task was last installed under is recorded here, so that it can still be found
+    // after task-name has been changed in the config.
+    constexpr LPCWSTR SETTINGS_KEY = L"SOFTWARE\\TransitionFixer";
+    constexpr LPCWSTR INSTALLED_TASK_NAME_VALUE = L"InstalledTaskName";
+
+    std::wstring GetInstalledTaskName()
+    {
+        return GetRegistryString(HKEY_CURRENT_USER, SETTINGS_KEY, INSTALLED_TASK_NAME_VALUE);
+    }
+
+    void SetInstalledTaskName(const std::wstring& name)
+    {
+        THROW_IF_WIN32_ERROR(RegSetKeyValueW(
+            HKEY_CURRENT_USER,
+            SETTINGS_KEY,
+            INSTALLED_TASK_NAME_VALUE,
+            REG_SZ,
+            name.c_str(),
+            static_cast<DWORD>((name.size() + 1) * sizeof(wchar_t))));
+    }
+
+    void ClearInstalledTaskName()
+    {
+        RegDeleteKeyValueW(HKEY_CURRENT_USER, SETTINGS_KEY, INSTALLED_TASK_NAME_VALUE);
+    }
+
     std::wstring GetCurrentDateTime()
     {
         std::wstringstream stream;
@@ -42,18 +71,48 @@ namespace {
         }
     }
 
-    void SetRegisterationInfo(ITaskDefinition* task)
+    std::wstring ToWString(const wil::unique_bstr& value)
+    {
+        if (!value) {
+            return std::wstring();
+        }
+
+        return std::wstring(value.get(), SysStringLen(value.get()));
+    }
+
+    std::wstring ToAccountName(const std::wstring& userID)
+    {
+        // The Task Scheduler may hand back a SID instead of the DOMAIN\user name we registered
+        // the task with, so look up the name it refers to. If it can't be resolved, leave it be;
+        // the task will just be treated as out of date.
+        PSID rawSid = nullptr;
+        if (userID.compare(0, 2, L"S-") != 0 || !ConvertStringSidToSidW(userID.c_str(), &rawSid)) {
+            return userID;
+        }
+
+        wil::unique_hlocal sid(rawSid);
+
+        WCHAR name[UNLEN + 1];
+        WCHAR domain[DNLEN + 1];
+        DWORD nameSize = ARRAYSIZE(name);
+        DWORD domainSize = ARRAYSIZE(domain);
+        SID_NAME_USE use;
+        if (!LookupAccountSidW(nullptr, sid.get(), name, &nameSize, domain, &domainSize, &use)) {
+            return userID;
+        }
+
+        return std::wstring(domain) + L"\\" + name;
+    }
+
+    void SetRegisterationInfo(ITaskDefinition* task, const TaskSpec& spec)
     {
         wil::com_ptr_t<IRegistrationInfo> registrationInfo;
         THROW_IF_FAILED(task->get_RegistrationInfo(&registrationInfo));
 
         auto currentDateTime = GetCurrentDateTime();
-        auto author = wil::make_bstr(L"Limotto Productions");
-        auto description = wil::make_bstr(
-            L"Fixes an issue where the Windows desktop does not play a fade transition effect "
-            L"when changing wallpapers by enabling Active Desktop."
-        );
-        auto version = wil::make_bstr(L"1.0");
+        auto author = wil::make_bstr(spec.author.c_str());
+        auto description = wil::make_bstr(spec.description.c_str());
+        auto version = wil::make_bstr(spec.version.c_str());
         auto date = wil::make_bstr(currentDateTime.c_str());
 
         registrationInfo->put_Author(author.get());
@@ -62,15 +121,26 @@ namespace {
         registrationInfo->put_Date(date.get());
     }
 
-    void SetSettings(ITaskDefinition* task)
+    void SetSettings(ITaskDefinition* task, const TaskSpec& spec)
     {
         wil::com_ptr_t<ITaskSettings> settings;
         THROW_IF_FAILED(task->get_Settings(&settings));
 
-        settings->put_StartWhenAvailable(VARIANT_TRUE);
+        settings->put_StartWhenAvailable(spec.startWhenAvailable ? VARIANT_TRUE : VARIANT_FALSE);
+        settings->put_Enabled(spec.enabled ? VARIANT_TRUE : VARIANT_FALSE);
     }
 
-    void SetTriggers(ITaskDefinition* task)
+    void SetPrincipal(ITaskDefinition* task, const TaskSpec& spec)
+    {
+        wil::com_ptr_t<IPrincipal> principal;
+        THROW_IF_FAILED(task->get_Principal(&principal));
+
+        auto userID = wil::make_bstr(spec.principalUserID.c_str());
+        THROW_IF_FAILED(principal->put_UserId(userID.get()));
+        THROW_IF_FAILED(principal->put_LogonType(static_cast<TASK_LOGON_TYPE>(spec.logonType)));
+    }
+
+    void SetTriggers(ITaskDefinition* task, const TaskSpec& spec)
     {
         wil::com_ptr_t<ITriggerCollection> triggerCollection;
         THROW_IF_FAILED(task->get_Triggers(&triggerCollection));
@@ -80,15 +150,14 @@ namespace {
         THROW_IF_FAILED(triggerCollection->Create(TASK_TRIGGER_LOGON, &trigger));
         wil::com_ptr_t<ILogonTrigger> logonTrigger = trigger.query<ILogonTrigger>();
 
-        std::wstring userID = GetUserID();
-        auto userIDBStr = wil::make_bstr(userID.c_str());
-        auto delay = wil::make_bstr(L"PT30S"); // Put a 30s delay, in case Explorer hasn't initialized immediately.
+        auto userIDBStr = wil::make_bstr(spec.userID.c_str());
+        auto delay = wil::make_bstr(spec.delay.c_str());
 
-        logonTrigger->put_UserId(userIDBStr.get());
-        logonTrigger->put_Delay(delay.get()); 
+        THROW_IF_FAILED(logonTrigger->put_UserId(userIDBStr.get()));
+        THROW_IF_FAILED(logonTrigger->put_Delay(delay.get()));
     }
 
-    void SetAction(ITaskDefinition* task)
+    void SetAction(ITaskDefinition* task, const TaskSpec& spec)
     {
         // Get the action collections for this task
         wil::com_ptr_t<IActionCollection> actionCollection;
@@ -99,37 +168,234 @@ namespace {
         THROW_IF_FAILED(actionCollection->Create(TASK_ACTION_EXEC, &action));
         wil::com_ptr_t<IExecAction> execAction = action.query<IExecAction>();
 
-        std::wstring execPath = GetExePath();
-        std::wstring execPathWithoutName = execPath.substr(0, execPath.find_last_of('\\'));
-        auto path = wil::make_bstr(execPath.c_str());
-        auto workingDir = wil::make_bstr(execPathWithoutName.c_str());
-        auto arguments = wil::make_bstr(L"run");
+        auto path = wil::make_bstr(spec.path.c_str());
+        auto workingDir = wil::make_bstr(spec.workingDirectory.c_str());
+        auto arguments = wil::make_bstr(spec.arguments.c_str());
 
         execAction->put_Path(path.get());
         execAction->put_WorkingDirectory(workingDir.get());
         execAction->put_Arguments(arguments.get());
     }
 
-    void SaveTask(ITaskFolder* rootFolder, ITaskDefinition* task)
+    bool GetRegisterationInfo(ITaskDefinition* task, TaskSpec& spec)
+    {
+        wil::com_ptr_t<IRegistrationInfo> registrationInfo;
+        THROW_IF_FAILED(task->get_RegistrationInfo(&registrationInfo));
+
+        wil::unique_bstr author;
+        wil::unique_bstr description;
+        wil::unique_bstr version;
+        THROW_IF_FAILED(registrationInfo->get_Author(&author));
+        THROW_IF_FAILED(registrationInfo->get_Description(&description));
+        THROW_IF_FAILED(registrationInfo->get_Version(&version));
+
+        spec.author = ToWString(author);
+        spec.description = ToWString(description);
+        spec.version = ToWString(version);
+        return true;
+    }
+
+    bool GetSettings(ITaskDefinition* task, TaskSpec& spec)
+    {
+        wil::com_ptr_t<ITaskSettings> settings;
+        THROW_IF_FAILED(task->get_Settings(&settings));
+
+        VARIANT_BOOL startWhenAvailable = VARIANT_FALSE;
+        VARIANT_BOOL enabled = VARIANT_FALSE;
+        THROW_IF_FAILED(settings->get_StartWhenAvailable(&startWhenAvailable));
+        THROW_IF_FAILED(settings->get_Enabled(&enabled));
+
+        spec.startWhenAvailable = startWhenAvailable != VARIANT_FALSE;
+        spec.enabled = enabled != VARIANT_FALSE;
+        return true;
+    }
+
+    bool GetPrincipal(ITaskDefinition* task, TaskSpec& spec)
+    {
+        wil::com_ptr_t<IPrincipal> principal;
+        THROW_IF_FAILED(task->get_Principal(&principal));
+
+        wil::unique_bstr userID;
+        TASK_LOGON_TYPE logonType = TASK_LOGON_NONE;
+        THROW_IF_FAILED(principal->get_UserId(&userID));
+        THROW_IF_FAILED(principal->get_LogonType(&logonType));
+
+        spec.principalUserID = ToAccountName(ToWString(userID));
+        spec.logonType = static_cast<std::uint32_t>(logonType);
+        return true;
+    }
+
+    bool GetTriggers(ITaskDefinition* task, TaskSpec& spec)
+    {
+        wil::com_ptr_t<ITriggerCollection> triggerCollection;
+        THROW_IF_FAILED(task->get_Triggers(&triggerCollection));
+
+        // We only ever register a single logon trigger, so anything else means that the task
+        // has been changed behind our back.
+        LONG count = 0;
+        THROW_IF_FAILED(triggerCollection->get_Count(&count));
+        if (count != 1) {
+            return false;
+        }
+
+        // NOTE: Task Scheduler collections are 1-based.
+        wil::com_ptr_t<ITrigger> trigger;
+        THROW_IF_FAILED(triggerCollection->get_Item(1, &trigger));
+
+        TASK_TRIGGER_TYPE2 type;
+        THROW_IF_FAILED(trigger->get_Type(&type));
+        if (type != TASK_TRIGGER_LOGON) {
+            return false;
+        }
+
+        wil::com_ptr_t<ILogonTrigger> logonTrigger = trigger.query<ILogonTrigger>();
+        wil::unique_bstr userID;
+        wil::unique_bstr delay;
+        THROW_IF_FAILED(logonTrigger->get_UserId(&userID));
+        THROW_IF_FAILED(logonTrigger->get_Delay(&delay));
+
+        spec.userID = ToAccountName(ToWString(userID));
+        spec.delay = ToWString(delay);
+        return true;
+    }
+
+    bool GetAction(ITaskDefinition* task, TaskSpec& spec)
+    {
+        wil::com_ptr_t<IActionCollection> actionCollection;
+        THROW_IF_FAILED(task->get_Actions(&actionCollection));
+
+        // Same as the triggers, we only ever register a single executable action.
+        LONG count = 0;
+        THROW_IF_FAILED(actionCollection->get_Count(&count));
+        if (count != 1) {
+            return false;
+        }
+
+        wil::com_ptr_t<IAction> action;
+        THROW_IF_FAILED(actionCollection->get_Item(1, &action));
+
+        TASK_ACTION_TYPE type;
+        THROW_IF_FAILED(action->get_Type(&type));
+        if (type != TASK_ACTION_EXEC) {
+            return false;
+        }
+
+        wil::com_ptr_t<IExecAction> execAction = action.query<IExecAction>();
+        wil::unique_bstr path;
+        wil::unique_bstr workingDir;
+        wil::unique_bstr arguments;
+        THROW_IF_FAILED(execAction->get_Path(&path));
+        THROW_IF_FAILED(execAction->get_WorkingDirectory(&workingDir));
+        THROW_IF_FAILED(execAction->get_Arguments(&arguments));
+
+        spec.path = ToWString(path);
+        spec.workingDirectory = ToWString(workingDir);
+        spec.arguments = ToWString(arguments);
+        return true;
+    }
+
+    TaskSpec GetTaskSpec()
     {
-        std::wstring currentUser = GetUserID();
-        auto taskName = wil::make_bstr(L"Transition Fixer");
+        std::wstring execPath = GetExePath();
 
-        wil::com_ptr_t<IRegisteredTask> registeredTask;
-        THROW_IF_FAILED(rootFolder->RegisterTaskDefinition(
-            taskName.get(),
-            task,
-            TASK_CREATE_OR_UPDATE,
-            _variant_t(currentUser.c_str()),
-            _variant_t(),
-            TASK_LOGON_NONE,
-            _variant_t(L""),
-            &registeredTask)
-        );
+        TaskSpec spec;
+        spec.author = L"Limotto Productions";
+        spec.description =
+            L"Fixes an issue where the Windows desktop does not play a fade transition effect "
+            L"when changing wallpapers by enabling Active Desktop.";
+        spec.version = L"1.0";
+        spec.startWhenAvailable = true;
+        spec.enabled = true;
+        spec.principalUserID = GetUserID();
+        spec.logonType = TASK_LOGON_INTERACTIVE_TOKEN; // Only run while the user is logged on, since we need their desktop.
+        spec.userID = GetUserID();
+        spec.delay = GetConfig().taskDelay;
+        spec.path = execPath;
+        spec.workingDirectory = execPath.substr(0, execPath.find_last_of('\\'));
+        spec.arguments = L"run";
+
+        return spec;
     }
+
+    /// <summary>
+    /// A <see cref="TaskStore" /> that is backed by a folder in the Windows Task Scheduler.
+    /// </summary>
+    class TaskSchedulerStore : public TaskStore {
+    public:
+        TaskSchedulerStore(ITaskService* taskService, ITaskFolder* folder)
+            : m_taskService(taskService), m_folder(folder)
+        {
+        }
+
+        bool TryGetTask(const std::wstring& name, TaskSpec& spec) override
+        {
+            auto taskName = wil::make_bstr(name.c_str());
+
+            wil::com_ptr_t<IRegisteredTask> registeredTask;
+            if (FAILED(m_folder->GetTask(taskName.get(), &registeredTask))) {
+                // The task hasn't been registered yet.
+                return false;
+            }
+
+            // If the registered task can't be read for whatever reason, treat it as out of date
+            // so that it gets overwritten (and hopefully repaired).
+            try {
+                wil::com_ptr_t<ITaskDefinition> task;
+                THROW_IF_FAILED(registeredTask->get_Definition(&task));
+
+                return GetRegisterationInfo(task.get(), spec)
+                    && GetSettings(task.get(), spec)
+                    && GetPrincipal(task.get(), spec)
+                    && GetTriggers(task.get(), spec)
+                    && GetAction(task.get(), spec);
+            }
+            catch (const wil::ResultException&) {
+                return false;
+            }
+        }
+
+        void SaveTask(const std::wstring& name, const TaskSpec& spec) override
+        {
+            // Create a task builder object to create the task
+            wil::com_ptr<ITaskDefinition> task;
+            THROW_IF_FAILED(m_taskService->NewTask(0, &task));
+
+            // Start setting up the task
+            SetRegisterationInfo(task.get(), spec);
+            SetSettings(task.get(), spec);
+            SetPrincipal(task.get(), spec);
+            SetTriggers(task.get(), spec);
+            SetAction(task.get(), spec);
+
+            auto taskName = wil::make_bstr(name.c_str());
+
+            wil::com_ptr_t<IRegisteredTask> registeredTask;
+            THROW_IF_FAILED(m_folder->RegisterTaskDefinition(
+                taskName.get(),
+                task.get(),
+                TASK_CREATE_OR_UPDATE,
+                _variant_t(spec.principalUserID.c_str()),
+                _variant_t(),
+                static_cast<TASK_LOGON_TYPE>(spec.logonType),
+                _variant_t(L""),
+                &registeredTask)
+            );
+        }
+
+        bool DeleteTask(const std::wstring& name) override
+        {
+            auto taskName = wil::make_bstr(name.c_str());
+
+            return SUCCEEDED(m_folder->DeleteTask(taskName.get(), 0));
+        }
+
+    private:
+        ITaskService* m_taskService;
+        ITaskFolder* m_folder;
+    };
 }
 
-bool InstallTask()
+TaskInstallResult InstallTask()
 {
     // Initialize COM, using wil::CoInitializeEx so that we don't need to worry about
     // cleaning up after ourselves.
@@ -157,18 +423,18 @@ bool InstallTask()
     wil::com_ptr<ITaskFolder> rootFolder;
     THROW_IF_FAILED(taskService->GetFolder(rootFolderPath.get(), &rootFolder));
 
-    // Create a task builder object to create the task
-    wil::com_ptr<ITaskDefinition> task;
-    THROW_IF_FAILED(taskService->NewTask(0, &task));
-
-    // Start setting up the task
-    SetRegisterationInfo(task.get());
-    SetSettings(task.get());
-    SetTriggers(task.get());
-    SetAction(task.get());
-    SaveTask(rootFolder.get(), task.get());
+    // Only register the task if it differs from what's already there, so that reruns don't
+    // rewrite the task (and its registration date) every time.
+    // If the task was installed under a different name before, that task is replaced as well.
+    TaskSchedulerStore store(taskService.get(), rootFolder.get());
+    const std::wstring& taskName = GetConfig().taskName;
+    std::wstring installedName = GetInstalledTaskName();
+    TaskInstallResult result = InstallTaskSpec(store, taskName, GetTaskSpec(), installedName);
+    if (installedName != taskName) {
+        SetInstalledTaskName(taskName);
+    }
 
-	return true;
+    return result;
 }
 
 bool UninstallTask()
@@ -199,7 +465,11 @@ bool UninstallTask()
     wil::com_ptr<ITaskFolder> rootFolder;
     THROW_IF_FAILED(taskService->GetFolder(rootFolderPath.get(), &rootFolder));
 
-    auto taskName = wil::make_bstr(L"Transition Fixer");
+    // Remove the task under the name it was installed with too, in case task-name has been
+    // changed since.
+    TaskSchedulerStore store(taskService.get(), rootFolder.get());
+    bool succeeded = UninstallTaskSpec(store, GetConfig().taskName, GetInstalledTaskName());
+    ClearInstalledTaskName();
 
-    return SUCCEEDED(rootFolder->DeleteTask(taskName.get(), 0));
+    return succeeded;
 }
\ No newline at end of file
@@ -1,10 +1,13 @@
 #ifndef TASK_SCHEDULER_H
 #define TASK_SCHEDULER_H
 
+#include "task_definition.h"
+
 /// <summary>
-/// Registers the task with the Windows Task Scheduler
+/// Registers the task with the Windows Task Scheduler, unless the registered task is already up to date
 /// </summary>
-bool InstallTask();
+/// <returns>Whether the task was saved or was already up to date.</returns>
+TaskInstallResult InstallTask();
 
 /// <summary>
 /// Removes the task with the Windows Task Scheduler
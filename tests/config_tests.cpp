@@ -0,0 +1,315 @@
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "config.h"
+#include "hash.h"
+#include "test.h"
+
+namespace {
+	// These mirror the snapshot layout in config.cpp, so that the tests can damage snapshots
+	// without the checksum giving them away.
+	constexpr std::size_t SIZE_OFFSET = 8;
+	constexpr std::size_t CHECKSUM_OFFSET = 12;
+	constexpr std::size_t TARGET_COUNT_OFFSET = 20;
+	constexpr std::size_t HEADER_SIZE = 32;
+	constexpr std::size_t STRING_REF_SIZE = 8;
+
+	std::uint32_t ReadUInt32(const std::vector<unsigned char>& snapshot, std::size_t offset)
+	{
+		std::uint32_t value;
+		std::memcpy(&value, snapshot.data() + offset, sizeof(value));
+
+		return value;
+	}
+
+	void WriteUInt32(std::vector<unsigned char>& snapshot, std::size_t offset, std::uint32_t value)
+	{
+		std::memcpy(snapshot.data() + offset, &value, sizeof(value));
+	}
+
+	/// <summary>
+	/// Recomputes the size and checksum of a snapshot after it has been modified.
+	/// </summary>
+	void Reseal(std::vector<unsigned char>& snapshot)
+	{
+		WriteUInt32(snapshot, SIZE_OFFSET, static_cast<std::uint32_t>(snapshot.size()));
+
+		const std::size_t start = CHECKSUM_OFFSET + sizeof(std::uint32_t);
+		std::uint64_t hash = Hash::Fnv1a(Hash::FNV_OFFSET_BASIS, snapshot.data() + start, snapshot.size() - start);
+		WriteUInt32(snapshot, CHECKSUM_OFFSET, static_cast<std::uint32_t>(hash ^ (hash >> 32)));
+	}
+
+	bool Parse(const std::string& text, Config& config)
+	{
+		std::string error;
+		return ParseConfig(text, config, error);
+	}
+
+	bool Equals(const Config& first, const Config& second)
+	{
+		return first.targets == second.targets
+			&& first.timeoutMs == second.timeoutMs
+			&& first.taskName == second.taskName
+			&& first.taskDelay == second.taskDelay;
+	}
+
+	Config MakeConfig()
+	{
+		Config config;
+		config.targets = { L"Progman", L"WorkerW" };
+		config.timeoutMs = 1500;
+		config.taskName = L"Transition Fixer (Test)";
+		config.taskDelay = L"PT1M";
+
+		return config;
+	}
+
+	void EmptyFileGivesTheDefaults()
+	{
+		Config config;
+		CHECK(Parse("", config));
+		CHECK(Equals(config, GetDefaultConfig()));
+
+		CHECK(Parse("# Only a comment\n\n   \n", config));
+		CHECK(Equals(config, GetDefaultConfig()));
+	}
+
+	void ValuesAreParsed()
+	{
+		Config config;
+		CHECK(Parse(
+			"# Tuned for this deployment\r\n"
+			"timeout-ms = 1500\r\n"
+			"  task-name=Transition Fixer (Test)  \r\n"
+			"task-delay = PT1M\r\n",
+			config));
+		CHECK(config.targets == GetDefaultConfig().targets);
+		CHECK(config.timeoutMs == 1500);
+		CHECK(config.taskName == L"Transition Fixer (Test)");
+		CHECK(config.taskDelay == L"PT1M");
+	}
+
+	void RepeatedTargetReplacesTheDefaults()
+	{
+		Config config;
+		CHECK(Parse("target = WorkerW\ntarget = Progman\ntarget = WorkerW\n", config));
+		CHECK((config.targets == std::vector<std::wstring>{ L"WorkerW", L"Progman", L"WorkerW" }));
+
+		std::string tooMany;
+		for (int i = 0; i <= 64; ++i) {
+			tooMany += "target = Window" + std::to_string(i) + "\n";
+		}
+
+		CHECK(!Parse(tooMany, config));
+	}
+
+	void BadValuesAreRejected()
+	{
+		const char* invalid[] = {
+			"timeout-ms = 0",
+			"timeout-ms = -1",
+			"timeout-ms = 500ms",
+			"timeout-ms = 4294967296",
+			"timeout-ms =",
+			"task-name =",
+			"target =",
+			"just some text",
+			"task-name = \xFF\xFE",
+		};
+
+		for (const char* text : invalid) {
+			Config config;
+			std::string error;
+			CHECK(!ParseConfig(text, config, error));
+			CHECK(!error.empty());
+		}
+
+		std::string error;
+		Config config;
+		CHECK(!ParseConfig("\n\ntimeout-ms = zero\n", config, error));
+		CHECK(error.find("line 3") != std::string::npos);
+	}
+
+	void TaskDelayMustBeADuration()
+	{
+		const char* valid[] = { "PT30S", "PT0S", "PT1M", "PT1H30M", "P1D", "P1DT12H", "P1Y2M3DT4H5M6S" };
+		for (const char* delay : valid) {
+			Config config;
+			CHECK(Parse(std::string("task-delay = ") + delay, config));
+			CHECK(config.taskDelay == std::wstring(delay, delay + std::strlen(delay)));
+		}
+
+		const char* invalid[] = { "", "30", "30S", "P", "PT", "P1DT", "PT30", "PTS", "PT1S30M", "PT1H1H", "P1H", "PT1D", "PT30s", "PT-1S", "PT1.5S", "P1DT1HT1M" };
+		for (const char* delay : invalid) {
+			Config config;
+			CHECK(!Parse(std::string("task-delay = ") + delay, config));
+		}
+	}
+
+	void UnknownKeysAreRejected()
+	{
+		Config config;
+		std::string error;
+		CHECK(!ParseConfig("timeout = 500\n", config, error));
+		CHECK(error.find("timeout") != std::string::npos);
+		CHECK(!ParseConfig("Target = Progman\n", config, error));
+	}
+
+	void ByteOrderMarkIsSkipped()
+	{
+		Config config;
+		CHECK(Parse("\xEF\xBB\xBFtimeout-ms = 750\n", config));
+		CHECK(config.timeoutMs == 750);
+
+		CHECK(Parse("\xEF\xBB\xBF", config));
+		CHECK(Equals(config, GetDefaultConfig()));
+	}
+
+	void SnapshotRoundTrips()
+	{
+		Config configs[] = { GetDefaultConfig(), MakeConfig() };
+		for (const Config& config : configs) {
+			std::vector<unsigned char> snapshot = CompileConfig(config);
+
+			Config loaded;
+			CHECK(LoadConfigSnapshot(snapshot.data(), snapshot.size(), loaded));
+			CHECK(Equals(loaded, config));
+		}
+	}
+
+	void SnapshotRoundTripsNonAsciiText()
+	{
+		// U+00E9 and U+4E2D fit into a single UTF-16 code unit, U+1F600 needs a surrogate pair.
+		Config config;
+		CHECK(Parse("task-name = Caf\xC3\xA9 \xE4\xB8\xAD \xF0\x9F\x98\x80\ntarget = \xF0\x9F\x98\x80\n", config));
+
+		std::wstring expected = L"Caf\u00E9 \u4E2D ";
+		if (sizeof(wchar_t) == 2) {
+			expected += static_cast<wchar_t>(0xD83D);
+			expected += static_cast<wchar_t>(0xDE00);
+		}
+		else {
+			expected += static_cast<wchar_t>(0x1F600);
+		}
+
+		CHECK(config.taskName == expected);
+
+		std::vector<unsigned char> snapshot = CompileConfig(config);
+
+		// The snapshot always stores UTF-16, whatever the size of wchar_t.
+		std::uint32_t taskNameOffset = ReadUInt32(snapshot, HEADER_SIZE);
+		std::uint32_t taskNameLength = ReadUInt32(snapshot, HEADER_SIZE + sizeof(std::uint32_t));
+		CHECK(taskNameLength == 9);
+		if (taskNameLength == 9) {
+			std::uint16_t pair[2];
+			std::memcpy(pair, snapshot.data() + taskNameOffset + 7 * sizeof(std::uint16_t), sizeof(pair));
+			CHECK(pair[0] == 0xD83D);
+			CHECK(pair[1] == 0xDE00);
+		}
+
+		Config loaded;
+		CHECK(LoadConfigSnapshot(snapshot.data(), snapshot.size(), loaded));
+		CHECK(Equals(loaded, config));
+	}
+
+	void WrongSizeIsRejected()
+	{
+		std::vector<unsigned char> snapshot = CompileConfig(MakeConfig());
+		Config loaded;
+
+		CHECK(!LoadConfigSnapshot(snapshot.data(), snapshot.size() - 1, loaded));
+		CHECK(!LoadConfigSnapshot(snapshot.data(), HEADER_SIZE - 1, loaded));
+		CHECK(!LoadConfigSnapshot(nullptr, 0, loaded));
+
+		std::vector<unsigned char> longer = snapshot;
+		longer.push_back(0);
+		CHECK(!LoadConfigSnapshot(longer.data(), longer.size(), loaded));
+
+		// A header that covers only part of the string references can't be loaded either, even
+		// when its size and checksum agree.
+		std::vector<unsigned char> truncated(snapshot.begin(), snapshot.begin() + HEADER_SIZE + STRING_REF_SIZE);
+		Reseal(truncated);
+		CHECK(!LoadConfigSnapshot(truncated.data(), truncated.size(), loaded));
+	}
+
+	void BadChecksumIsRejected()
+	{
+		std::vector<unsigned char> snapshot = CompileConfig(MakeConfig());
+		snapshot.back() ^= 0x01;
+
+		Config loaded = GetDefaultConfig();
+		CHECK(!LoadConfigSnapshot(snapshot.data(), snapshot.size(), loaded));
+		CHECK(Equals(loaded, GetDefaultConfig()));
+	}
+
+	void BadTargetCountIsRejected()
+	{
+		std::uint32_t counts[] = { 0, 3, 65, 0xFFFFFFFF };
+		for (std::uint32_t count : counts) {
+			std::vector<unsigned char> snapshot = CompileConfig(MakeConfig());
+			WriteUInt32(snapshot, TARGET_COUNT_OFFSET, count);
+			Reseal(snapshot);
+
+			Config loaded;
+			CHECK(!LoadConfigSnapshot(snapshot.data(), snapshot.size(), loaded));
+		}
+	}
+
+	void OutOfRangeStringIsRejected()
+	{
+		std::vector<unsigned char> original = CompileConfig(MakeConfig());
+		const std::uint32_t size = static_cast<std::uint32_t>(original.size());
+
+		// Each pair is an offset and a length for the last string reference (the second target).
+		const std::uint32_t refs[][2] = {
+			{ size, 1 },
+			{ size + 2, 0 },
+			{ size - 2, 2 },
+			{ 0xFFFFFFFE, 1 },
+			{ static_cast<std::uint32_t>(HEADER_SIZE + 1), 1 },
+			{ static_cast<std::uint32_t>(HEADER_SIZE), 0x80000000 },
+		};
+
+		const std::size_t lastRef = HEADER_SIZE + 3 * STRING_REF_SIZE;
+		for (const auto& ref : refs) {
+			std::vector<unsigned char> snapshot = original;
+			WriteUInt32(snapshot, lastRef, ref[0]);
+			WriteUInt32(snapshot, lastRef + sizeof(std::uint32_t), ref[1]);
+			Reseal(snapshot);
+
+			Config loaded;
+			CHECK(!LoadConfigSnapshot(snapshot.data(), snapshot.size(), loaded));
+		}
+
+		// A reference to the very end of the snapshot is fine as long as it's empty.
+		std::vector<unsigned char> snapshot = original;
+		WriteUInt32(snapshot, lastRef, size);
+		WriteUInt32(snapshot, lastRef + sizeof(std::uint32_t), 0);
+		Reseal(snapshot);
+
+		Config loaded;
+		CHECK(LoadConfigSnapshot(snapshot.data(), snapshot.size(), loaded));
+		CHECK(loaded.targets.size() == 2 && loaded.targets[1].empty());
+	}
+}
+
+int main()
+{
+	RUN_TEST(EmptyFileGivesTheDefaults);
+	RUN_TEST(ValuesAreParsed);
+	RUN_TEST(RepeatedTargetReplacesTheDefaults);
+	RUN_TEST(BadValuesAreRejected);
+	RUN_TEST(TaskDelayMustBeADuration);
+	RUN_TEST(UnknownKeysAreRejected);
+	RUN_TEST(ByteOrderMarkIsSkipped);
+	RUN_TEST(SnapshotRoundTrips);
+	RUN_TEST(SnapshotRoundTripsNonAsciiText);
+	RUN_TEST(WrongSizeIsRejected);
+	RUN_TEST(BadChecksumIsRejected);
+	RUN_TEST(BadTargetCountIsRejected);
+	RUN_TEST(OutOfRangeStringIsRejected);
+
+	return TEST_EXIT_CODE();
+}
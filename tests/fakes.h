@@ -0,0 +1,117 @@
+#ifndef FAKES_H
+#define FAKES_H
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "message_probe.h"
+#include "task_definition.h"
+
+// In-memory implementations of the platform interfaces, shared by the unit tests and the soak
+// harness in tools/soak.
+
+/// <summary>
+/// Stands in for the shell the way Win32 behaves: every variant is delivered as long as the window
+/// exists and responds, but only one of them enables Active Desktop, and whether it's enabled is
+/// checked separately afterwards. Every variant it's asked to send is recorded.
+/// </summary>
+class FakeMessageSender : public MessageSender {
+public:
+	SendResult Send(const MessageVariant& variant) override
+	{
+		sent.push_back(variant);
+		if (std::find(missingClasses.begin(), missingClasses.end(), variant.windowClass) != missingClasses.end()) {
+			return SendResult::WindowNotFound;
+		}
+
+		if (!responding) {
+			return SendResult::NotResponding;
+		}
+
+		const MessageVariant& accepted = variants[acceptedIndex];
+		if (variant.windowClass == accepted.windowClass
+			&& variant.message == accepted.message
+			&& variant.wParam == accepted.wParam
+			&& variant.lParam == accepted.lParam) {
+			activeDesktopEnabled = true;
+		}
+
+		if (!confirmable) {
+			return SendResult::Unconfirmed;
+		}
+
+		return activeDesktopEnabled ? SendResult::Applied : SendResult::NoEffect;
+	}
+
+	std::vector<MessageVariant> variants;
+
+	/// <summary>The variant that enables Active Desktop.</summary>
+	std::size_t acceptedIndex = 0;
+
+	std::vector<std::wstring> missingClasses;
+	bool responding = true;
+
+	/// <summary>Whether the effect can be checked, i.e. whether the window layout is a known one.</summary>
+	bool confirmable = true;
+
+	/// <summary>Whether Active Desktop is enabled. Clear it to start a new session.</summary>
+	bool activeDesktopEnabled = false;
+
+	std::vector<MessageVariant> sent;
+};
+
+class FakeProbeCache : public ProbeCache {
+public:
+	bool TryGet(const std::wstring& key, std::uint32_t& index) override
+	{
+		auto entry = entries.find(key);
+		if (entry == entries.end()) {
+			return false;
+		}
+
+		index = entry->second;
+		return true;
+	}
+
+	void Set(const std::wstring& key, std::uint32_t index) override
+	{
+		entries[key] = index;
+		++sets;
+	}
+
+	std::map<std::wstring, std::uint32_t> entries;
+	std::uint64_t sets = 0;
+};
+
+class FakeTaskStore : public TaskStore {
+public:
+	bool TryGetTask(const std::wstring& name, TaskSpec& spec) override
+	{
+		auto entry = tasks.find(name);
+		if (entry == tasks.end()) {
+			return false;
+		}
+
+		spec = entry->second;
+		return true;
+	}
+
+	void SaveTask(const std::wstring& name, const TaskSpec& spec) override
+	{
+		tasks[name] = spec;
+		++saves;
+	}
+
+	bool DeleteTask(const std::wstring& name) override
+	{
+		return tasks.erase(name) > 0;
+	}
+
+	std::map<std::wstring, TaskSpec> tasks;
+	std::uint64_t saves = 0;
+};
+
+#endif
@@ -0,0 +1,336 @@
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "journal.h"
+#include "test.h"
+
+namespace {
+	// These mirror the on-disk layout in journal.cpp, so that the tests can damage records.
+	constexpr std::size_t JOURNAL_HEADER_SIZE = 64;
+	constexpr std::size_t RECORD_HEADER_SIZE = 40;
+	constexpr std::uint32_t JOURNAL_FORMATTING = 0x2A4A4654;
+
+	/// <summary>
+	/// An 8-byte aligned block of memory with a journal attached to it.
+	/// </summary>
+	class TestJournal {
+	public:
+		explicit TestJournal(std::size_t capacity)
+			: m_block((GetJournalSize(capacity) + 7) / 8, 0)
+		{
+			attached = writer.Attach(GetData(), GetSize());
+		}
+
+		unsigned char* GetData()
+		{
+			return reinterpret_cast<unsigned char*>(m_block.data());
+		}
+
+		std::size_t GetSize() const
+		{
+			return m_block.size() * sizeof(std::uint64_t);
+		}
+
+		std::vector<JournalRecord> Read(const JournalFilter& filter = JournalFilter())
+		{
+			std::vector<JournalRecord> records;
+			readSucceeded = ReadJournal(GetData(), GetSize(), filter, [&](const JournalRecord& record) {
+				records.push_back(record);
+			});
+
+			return records;
+		}
+
+		JournalWriter writer;
+		bool attached = false;
+		bool readSucceeded = false;
+
+	private:
+		std::vector<std::uint64_t> m_block;
+	};
+
+	void AppendedRecordsAreReadBack()
+	{
+		TestJournal journal(4096);
+		CHECK(journal.attached);
+		CHECK(journal.writer.Append(JournalLevel::Info, 1000, L"first"));
+		CHECK(journal.writer.Append(JournalLevel::Warning, 2000, L"second"));
+		CHECK(journal.writer.Append(JournalLevel::Error, 3000, L""));
+
+		std::vector<JournalRecord> records = journal.Read();
+		CHECK(journal.readSucceeded);
+		CHECK(records.size() == 3);
+		if (records.size() == 3) {
+			CHECK(records[0].position == 0);
+			CHECK(records[0].timestamp == 1000);
+			CHECK(records[0].level == JournalLevel::Info);
+			CHECK(records[0].message == L"first");
+			CHECK(records[1].position > records[0].position);
+			CHECK(records[1].level == JournalLevel::Warning);
+			CHECK(records[1].message == L"second");
+			CHECK(records[2].level == JournalLevel::Error);
+			CHECK(records[2].message.empty());
+		}
+	}
+
+	void ReattachingKeepsTheRecords()
+	{
+		TestJournal journal(4096);
+		journal.writer.Append(JournalLevel::Info, 1000, L"kept");
+
+		JournalWriter other;
+		CHECK(other.Attach(journal.GetData(), journal.GetSize()));
+		other.Append(JournalLevel::Info, 2000, L"appended");
+
+		std::vector<JournalRecord> records = journal.Read();
+		CHECK(records.size() == 2);
+		if (records.size() == 2) {
+			CHECK(records[0].message == L"kept");
+			CHECK(records[1].message == L"appended");
+		}
+	}
+
+	void ConcurrentAttachFormatsOnce()
+	{
+		// Every writer attaches to the same fresh block and appends straight away. If more than
+		// one of them formatted the block, the later ones would wipe the earlier records.
+		const int writers = 8;
+		for (int round = 0; round < 200; ++round) {
+			std::vector<std::uint64_t> block((GetJournalSize(4096) + 7) / 8, 0);
+			std::atomic<int> ready{ 0 };
+			std::vector<std::thread> threads;
+			for (int i = 0; i < writers; ++i) {
+				threads.emplace_back([&block, &ready, i]() {
+					// Line everyone up first, so that they really do attach at the same time.
+					++ready;
+					while (ready < writers) {
+						std::this_thread::yield();
+					}
+
+					JournalWriter writer;
+					if (writer.Attach(block.data(), block.size() * sizeof(std::uint64_t))) {
+						writer.Append(JournalLevel::Info, i, L"attached");
+					}
+				});
+			}
+
+			for (auto& thread : threads) {
+				thread.join();
+			}
+
+			std::size_t count = 0;
+			ReadJournal(block.data(), block.size() * sizeof(std::uint64_t), JournalFilter(), [&](const JournalRecord&) {
+				++count;
+			});
+			CHECK(count == writers);
+		}
+	}
+
+	void AbandonedFormatIsTakenOver()
+	{
+		// A writer that died halfway through formatting mustn't leave the journal unusable.
+		TestJournal journal(4096);
+		journal.writer.Append(JournalLevel::Info, 1000, L"lost");
+		std::memcpy(journal.GetData(), &JOURNAL_FORMATTING, sizeof(JOURNAL_FORMATTING));
+
+		JournalWriter writer;
+		CHECK(writer.Attach(journal.GetData(), journal.GetSize()));
+		CHECK(writer.Append(JournalLevel::Info, 2000, L"recovered"));
+
+		std::vector<JournalRecord> records = journal.Read();
+		CHECK(records.size() == 1);
+		if (records.size() == 1) {
+			CHECK(records[0].message == L"recovered");
+		}
+	}
+
+	void WraparoundKeepsTheNewestRecords()
+	{
+		TestJournal journal(1024);
+		const int count = 200;
+		for (int i = 0; i < count; ++i) {
+			journal.writer.Append(JournalLevel::Info, i, L"message " + std::to_wstring(i));
+		}
+
+		std::vector<JournalRecord> records = journal.Read();
+		CHECK(!records.empty());
+		CHECK(records.size() < static_cast<std::size_t>(count));
+		if (!records.empty()) {
+			// What's left must be the newest records, in order and without gaps.
+			std::int64_t first = count - static_cast<std::int64_t>(records.size());
+			for (std::size_t i = 0; i < records.size(); ++i) {
+				CHECK(records[i].timestamp == first + static_cast<std::int64_t>(i));
+				CHECK(records[i].message == L"message " + std::to_wstring(first + static_cast<std::int64_t>(i)));
+			}
+
+			CHECK(records.back().timestamp == count - 1);
+		}
+	}
+
+	void OversizedMessageIsTruncated()
+	{
+		const std::size_t capacity = 1024;
+		TestJournal journal(capacity);
+		std::wstring message(capacity, L'x');
+		journal.writer.Append(JournalLevel::Error, 1000, message);
+
+		std::vector<JournalRecord> records = journal.Read();
+		CHECK(records.size() == 1);
+		if (records.size() == 1) {
+			CHECK(records[0].message.size() == (capacity / 2 - RECORD_HEADER_SIZE) / sizeof(std::uint16_t));
+			CHECK(message.compare(0, records[0].message.size(), records[0].message) == 0);
+		}
+	}
+
+	void TornRecordIsSkipped()
+	{
+		TestJournal journal(4096);
+		journal.writer.Append(JournalLevel::Info, 1000, L"torn");
+		journal.writer.Append(JournalLevel::Info, 2000, L"intact");
+
+		// Clear the commit marker of the first record, as if the writer died halfway through.
+		std::memset(journal.GetData() + JOURNAL_HEADER_SIZE, 0, sizeof(std::uint32_t));
+
+		std::vector<JournalRecord> records = journal.Read();
+		CHECK(journal.readSucceeded);
+		CHECK(records.size() == 1);
+		if (records.size() == 1) {
+			CHECK(records[0].message == L"intact");
+		}
+	}
+
+	void BadChecksumIsSkipped()
+	{
+		TestJournal journal(4096);
+		journal.writer.Append(JournalLevel::Info, 1000, L"corrupted");
+		journal.writer.Append(JournalLevel::Info, 2000, L"intact");
+
+		// Change the first character of the first record without updating its checksum.
+		journal.GetData()[JOURNAL_HEADER_SIZE + RECORD_HEADER_SIZE] = 'k';
+
+		std::vector<JournalRecord> records = journal.Read();
+		CHECK(records.size() == 1);
+		if (records.size() == 1) {
+			CHECK(records[0].message == L"intact");
+		}
+	}
+
+	void ConcurrentReadsOnlySeeWholeRecords()
+	{
+		// Keep overwriting a small journal while reading it. Every record that is returned must
+		// match what was written for its timestamp, however the reads and writes interleave.
+		TestJournal journal(512);
+		std::atomic<bool> done{ false };
+		std::thread writer([&]() {
+			for (int i = 0; i < 200000; ++i) {
+				journal.writer.Append(JournalLevel::Info, i, std::wstring(1 + i % 40, static_cast<wchar_t>(L'a' + i % 26)));
+			}
+
+			done = true;
+		});
+
+		std::size_t mismatches = 0;
+		while (!done) {
+			for (const JournalRecord& record : journal.Read()) {
+				std::int64_t i = record.timestamp;
+				if (record.message != std::wstring(1 + i % 40, static_cast<wchar_t>(L'a' + i % 26))) {
+					++mismatches;
+				}
+			}
+		}
+
+		writer.join();
+		CHECK(mismatches == 0);
+	}
+
+	void FiltersAreApplied()
+	{
+		TestJournal journal(4096);
+		journal.writer.Append(JournalLevel::Info, 1000, L"started");
+		journal.writer.Append(JournalLevel::Error, 2000, L"failed to send message");
+		journal.writer.Append(JournalLevel::Warning, 3000, L"cache miss");
+		journal.writer.Append(JournalLevel::Error, 4000, L"failed to locate window");
+
+		JournalFilter level;
+		level.minLevel = JournalLevel::Warning;
+		CHECK(journal.Read(level).size() == 3);
+
+		level.minLevel = JournalLevel::Error;
+		CHECK(journal.Read(level).size() == 2);
+
+		JournalFilter since;
+		since.since = 3000;
+		std::vector<JournalRecord> recent = journal.Read(since);
+		CHECK(recent.size() == 2);
+		if (recent.size() == 2) {
+			CHECK(recent[0].timestamp == 3000);
+		}
+
+		JournalFilter contains;
+		contains.contains = L"locate";
+		std::vector<JournalRecord> matching = journal.Read(contains);
+		CHECK(matching.size() == 1);
+		if (matching.size() == 1) {
+			CHECK(matching[0].timestamp == 4000);
+		}
+
+		JournalFilter combined;
+		combined.minLevel = JournalLevel::Error;
+		combined.since = 3000;
+		combined.contains = L"send";
+		CHECK(journal.Read(combined).empty());
+	}
+
+	void InvalidBlocksAreRejected()
+	{
+		std::vector<std::uint64_t> tooSmall(8, 0);
+		JournalWriter writer;
+		CHECK(!writer.Attach(tooSmall.data(), tooSmall.size() * sizeof(std::uint64_t)));
+		CHECK(!writer.Append(JournalLevel::Info, 0, L"not attached"));
+
+		std::vector<std::uint64_t> empty(512, 0);
+		bool called = false;
+		bool read = ReadJournal(empty.data(), empty.size() * sizeof(std::uint64_t), JournalFilter(), [&](const JournalRecord&) {
+			called = true;
+		});
+		CHECK(!read);
+		CHECK(!called);
+	}
+
+	void RecordsAreFormatted()
+	{
+		JournalRecord record;
+		record.timestamp = 1234;
+		record.level = JournalLevel::Warning;
+		record.message = L"message";
+		CHECK(FormatJournalRecord(record) == L"1970-01-01T00:00:01.234Z [warning] message");
+
+		JournalLevel level = JournalLevel::Info;
+		CHECK(ParseJournalLevel("error", level));
+		CHECK(level == JournalLevel::Error);
+		CHECK(!ParseJournalLevel("verbose", level));
+		CHECK(level == JournalLevel::Error);
+	}
+}
+
+int main()
+{
+	RUN_TEST(AppendedRecordsAreReadBack);
+	RUN_TEST(ReattachingKeepsTheRecords);
+	RUN_TEST(ConcurrentAttachFormatsOnce);
+	RUN_TEST(AbandonedFormatIsTakenOver);
+	RUN_TEST(WraparoundKeepsTheNewestRecords);
+	RUN_TEST(OversizedMessageIsTruncated);
+	RUN_TEST(TornRecordIsSkipped);
+	RUN_TEST(BadChecksumIsSkipped);
+	RUN_TEST(ConcurrentReadsOnlySeeWholeRecords);
+	RUN_TEST(FiltersAreApplied);
+	RUN_TEST(InvalidBlocksAreRejected);
+	RUN_TEST(RecordsAreFormatted);
+
+	return TEST_EXIT_CODE();
+}
@@ -0,0 +1,210 @@
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "fakes.h"
+#include "message_probe.h"
+#include "test.h"
+
+namespace {
+	constexpr const wchar_t* CACHE_KEY = L"19045|explorer.exe|key";
+
+	FakeMessageSender MakeSender(std::size_t acceptedIndex, const std::vector<std::wstring>& windowClasses = { L"Progman" })
+	{
+		FakeMessageSender sender;
+		sender.variants = GetKnownMessageVariants(windowClasses);
+		sender.acceptedIndex = acceptedIndex;
+
+		return sender;
+	}
+
+	void ColdProbeCachesTheVariantThatApplied()
+	{
+		FakeMessageSender sender = MakeSender(2);
+		FakeProbeCache cache;
+
+		ProbeResult result = ProbeAndSend(sender, cache, CACHE_KEY, sender.variants);
+		CHECK(result.succeeded);
+		CHECK(result.confirmed);
+		CHECK(result.windowFound);
+		CHECK(!result.fromCache);
+		CHECK(result.variantIndex == 2);
+		CHECK(result.attempts == 3);
+		CHECK(cache.entries[CACHE_KEY] == 2);
+	}
+
+	void CacheHitSendsOnlyTheCachedVariant()
+	{
+		FakeMessageSender sender = MakeSender(1);
+		FakeProbeCache cache;
+		cache.entries[CACHE_KEY] = 1;
+
+		ProbeResult result = ProbeAndSend(sender, cache, CACHE_KEY, sender.variants);
+		CHECK(result.succeeded);
+		CHECK(result.fromCache);
+		CHECK(result.variantIndex == 1);
+		CHECK(result.attempts == 1);
+		CHECK(cache.sets == 0);
+	}
+
+	void StaleCacheIsReplacedByTheVariantThatApplied()
+	{
+		FakeMessageSender sender = MakeSender(0);
+		FakeProbeCache cache;
+		cache.entries[CACHE_KEY] = 2;
+
+		ProbeResult result = ProbeAndSend(sender, cache, CACHE_KEY, sender.variants);
+		CHECK(result.succeeded);
+		CHECK(!result.fromCache);
+		CHECK(result.variantIndex == 0);
+		CHECK(result.attempts == 2);
+		CHECK(cache.entries[CACHE_KEY] == 0);
+
+		// The cached variant goes first, and isn't retried when the rest are probed in order.
+		CHECK(sender.sent.size() == 2);
+		CHECK(sender.sent[0].lParam == sender.variants[2].lParam);
+		CHECK(sender.sent[1].wParam == sender.variants[0].wParam);
+	}
+
+	void NoVariantAppliedLeavesTheCacheAlone()
+	{
+		FakeMessageSender sender = MakeSender(0);
+		FakeProbeCache cache;
+		cache.entries[CACHE_KEY] = 1;
+
+		// Accept something that isn't in the list, so every variant is delivered without effect.
+		sender.variants.push_back({ L"Progman", 0x0400, 0xFF, 0 });
+		sender.acceptedIndex = 3;
+
+		std::vector<MessageVariant> variants = GetKnownMessageVariants({ L"Progman" });
+		ProbeResult result = ProbeAndSend(sender, cache, CACHE_KEY, variants);
+		CHECK(!result.succeeded);
+		CHECK(result.windowFound);
+		CHECK(!result.notResponding);
+		CHECK(result.attempts == variants.size());
+		CHECK(cache.sets == 0);
+		CHECK(cache.entries[CACHE_KEY] == 1);
+	}
+
+	void UnresponsiveWindowStopsTheProbe()
+	{
+		FakeMessageSender sender = MakeSender(4, { L"Progman", L"CairoDesktop" });
+		sender.responding = false;
+		FakeProbeCache cache;
+		cache.entries[CACHE_KEY] = 1;
+
+		ProbeResult result = ProbeAndSend(sender, cache, CACHE_KEY, sender.variants);
+		CHECK(!result.succeeded);
+		CHECK(result.notResponding);
+		CHECK(result.attempts == 1);
+		CHECK(cache.sets == 0);
+		CHECK(cache.entries[CACHE_KEY] == 1);
+	}
+
+	void MissingWindowMovesOnToTheNextTarget()
+	{
+		// A shell replacement without a Progman window, which is what the ordered targets are for.
+		FakeMessageSender sender = MakeSender(4, { L"Progman", L"CairoDesktop" });
+		sender.missingClasses = { L"Progman" };
+		FakeProbeCache cache;
+
+		ProbeResult result = ProbeAndSend(sender, cache, CACHE_KEY, sender.variants);
+		CHECK(result.succeeded);
+		CHECK(result.variantIndex == 4);
+		CHECK(result.attempts == 3);
+		CHECK(cache.entries[CACHE_KEY] == 4);
+
+		// Only one variant is sent to the missing window, the rest of its variants are skipped.
+		CHECK(std::count_if(sender.sent.begin(), sender.sent.end(), [](const MessageVariant& variant) {
+			return variant.windowClass == L"Progman";
+		}) == 1);
+
+		// The same goes when the cached variant is for the missing window.
+		FakeMessageSender cachedSender = MakeSender(3, { L"Progman", L"CairoDesktop" });
+		cachedSender.missingClasses = { L"Progman" };
+		cache.entries[CACHE_KEY] = 1;
+
+		result = ProbeAndSend(cachedSender, cache, CACHE_KEY, cachedSender.variants);
+		CHECK(result.succeeded);
+		CHECK(result.variantIndex == 3);
+		CHECK(result.attempts == 2);
+		CHECK(cache.entries[CACHE_KEY] == 3);
+	}
+
+	void NoWindowsFoundFails()
+	{
+		FakeMessageSender sender = MakeSender(0, { L"Progman", L"CairoDesktop" });
+		sender.missingClasses = { L"Progman", L"CairoDesktop" };
+		FakeProbeCache cache;
+
+		ProbeResult result = ProbeAndSend(sender, cache, CACHE_KEY, sender.variants);
+		CHECK(!result.succeeded);
+		CHECK(!result.windowFound);
+		CHECK(!result.notResponding);
+		CHECK(result.attempts == 2);
+		CHECK(cache.sets == 0);
+	}
+
+	void UnconfirmedEffectSucceedsWithoutCaching()
+	{
+		FakeMessageSender sender = MakeSender(2);
+		sender.confirmable = false;
+		FakeProbeCache cache;
+
+		ProbeResult result = ProbeAndSend(sender, cache, CACHE_KEY, sender.variants);
+		CHECK(result.succeeded);
+		CHECK(!result.confirmed);
+		CHECK(result.variantIndex == 0);
+		CHECK(result.attempts == 1);
+		CHECK(cache.sets == 0);
+	}
+
+	void OutOfRangeCachedIndexIsIgnored()
+	{
+		FakeMessageSender sender = MakeSender(1);
+		FakeProbeCache cache;
+		cache.entries[CACHE_KEY] = 42;
+
+		ProbeResult result = ProbeAndSend(sender, cache, CACHE_KEY, sender.variants);
+		CHECK(result.succeeded);
+		CHECK(!result.fromCache);
+		CHECK(result.variantIndex == 1);
+		CHECK(result.attempts == 2);
+		CHECK(cache.entries[CACHE_KEY] == 1);
+	}
+
+	void CacheKeyCoversTheVariants()
+	{
+		std::vector<MessageVariant> variants = GetKnownMessageVariants({ L"Progman" });
+		std::wstring key = MakeProbeCacheKey(L"19045", L"explorer.exe", variants);
+		CHECK(key == MakeProbeCacheKey(L"19045", L"explorer.exe", GetKnownMessageVariants({ L"Progman" })));
+		CHECK(key.rfind(L"19045|explorer.exe|", 0) == 0);
+
+		CHECK(key != MakeProbeCacheKey(L"22631", L"explorer.exe", variants));
+		CHECK(key != MakeProbeCacheKey(L"19045", L"cairoshell.exe", variants));
+		CHECK(key != MakeProbeCacheKey(L"19045", L"explorer.exe", GetKnownMessageVariants({ L"Progman", L"WorkerW" })));
+
+		std::vector<MessageVariant> reordered = { variants[1], variants[0], variants[2] };
+		CHECK(key != MakeProbeCacheKey(L"19045", L"explorer.exe", reordered));
+
+		std::vector<MessageVariant> changed = variants;
+		changed[2].lParam = 2;
+		CHECK(key != MakeProbeCacheKey(L"19045", L"explorer.exe", changed));
+	}
+}
+
+int main()
+{
+	RUN_TEST(ColdProbeCachesTheVariantThatApplied);
+	RUN_TEST(CacheHitSendsOnlyTheCachedVariant);
+	RUN_TEST(StaleCacheIsReplacedByTheVariantThatApplied);
+	RUN_TEST(NoVariantAppliedLeavesTheCacheAlone);
+	RUN_TEST(UnresponsiveWindowStopsTheProbe);
+	RUN_TEST(MissingWindowMovesOnToTheNextTarget);
+	RUN_TEST(NoWindowsFoundFails);
+	RUN_TEST(UnconfirmedEffectSucceedsWithoutCaching);
+	RUN_TEST(OutOfRangeCachedIndexIsIgnored);
+	RUN_TEST(CacheKeyCoversTheVariants);
+
+	return TEST_EXIT_CODE();
+}
@@ -0,0 +1,154 @@
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "fakes.h"
+#include "task_definition.h"
+#include "test.h"
+
+namespace {
+	constexpr const wchar_t* TASK_NAME = L"Transition Fixer";
+
+	TaskSpec MakeSpec()
+	{
+		TaskSpec spec;
+		spec.author = L"Limotto Productions";
+		spec.description = L"Description";
+		spec.version = L"1.0";
+		spec.startWhenAvailable = true;
+		spec.enabled = true;
+		spec.principalUserID = L"DOMAIN\\user";
+		spec.logonType = 3;
+		spec.userID = L"DOMAIN\\user";
+		spec.delay = L"PT30S";
+		spec.path = L"C:\\TransitionFixer\\TransitionFixer.exe";
+		spec.workingDirectory = L"C:\\TransitionFixer";
+		spec.arguments = L"run";
+
+		return spec;
+	}
+
+	void MissingTaskIsSaved()
+	{
+		FakeTaskStore store;
+		CHECK(InstallTaskSpec(store, TASK_NAME, MakeSpec()) == TaskInstallResult::Saved);
+		CHECK(store.saves == 1);
+		CHECK(store.tasks.count(TASK_NAME) == 1);
+	}
+
+	void IdenticalTaskIsUpToDate()
+	{
+		FakeTaskStore store;
+		store.tasks[TASK_NAME] = MakeSpec();
+
+		CHECK(InstallTaskSpec(store, TASK_NAME, MakeSpec()) == TaskInstallResult::UpToDate);
+		CHECK(store.saves == 0);
+	}
+
+	void EachChangedFieldIsSaved()
+	{
+		std::vector<std::function<void(TaskSpec&)>> changes = {
+			[](TaskSpec& spec) { spec.author = L"Someone else"; },
+			[](TaskSpec& spec) { spec.description = L"Other"; },
+			[](TaskSpec& spec) { spec.version = L"2.0"; },
+			[](TaskSpec& spec) { spec.startWhenAvailable = false; },
+			[](TaskSpec& spec) { spec.enabled = false; },
+			[](TaskSpec& spec) { spec.principalUserID = L"DOMAIN\\other"; },
+			[](TaskSpec& spec) { spec.logonType = 0; },
+			[](TaskSpec& spec) { spec.userID = L"DOMAIN\\other"; },
+			[](TaskSpec& spec) { spec.delay = L"PT1M"; },
+			[](TaskSpec& spec) { spec.path = L"C:\\Other\\TransitionFixer.exe"; },
+			[](TaskSpec& spec) { spec.workingDirectory = L"C:\\Other"; },
+			[](TaskSpec& spec) { spec.arguments = L""; },
+		};
+
+		for (const auto& change : changes) {
+			TaskSpec registered = MakeSpec();
+			change(registered);
+
+			FakeTaskStore store;
+			store.tasks[TASK_NAME] = registered;
+
+			CHECK(HashTaskSpec(registered) != HashTaskSpec(MakeSpec()));
+			CHECK(InstallTaskSpec(store, TASK_NAME, MakeSpec()) == TaskInstallResult::Saved);
+			CHECK(store.saves == 1);
+			CHECK(HashTaskSpec(store.tasks[TASK_NAME]) == HashTaskSpec(MakeSpec()));
+		}
+	}
+
+	void DifferentlyCasedUserIsUpToDate()
+	{
+		// The Task Scheduler can hand back the account in a different case than it was registered with.
+		TaskSpec registered = MakeSpec();
+		registered.principalUserID = L"domain\\USER";
+		registered.userID = L"Domain\\User";
+
+		FakeTaskStore store;
+		store.tasks[TASK_NAME] = registered;
+
+		CHECK(NormalizeUserID(L"domain\\USER") == NormalizeUserID(L"DOMAIN\\user"));
+		CHECK(NormalizeUserID(L"DOMAIN\\user") != NormalizeUserID(L"DOMAIN\\other"));
+		CHECK(InstallTaskSpec(store, TASK_NAME, MakeSpec()) == TaskInstallResult::UpToDate);
+		CHECK(store.saves == 0);
+	}
+
+	void RenamedTaskReplacesTheOldOne()
+	{
+		FakeTaskStore store;
+		store.tasks[L"Old Name"] = MakeSpec();
+
+		CHECK(InstallTaskSpec(store, TASK_NAME, MakeSpec(), L"Old Name") == TaskInstallResult::Saved);
+		CHECK(store.tasks.count(TASK_NAME) == 1);
+		CHECK(store.tasks.count(L"Old Name") == 0);
+
+		// Task names are case-insensitive, so a name that only differs in case is the same task.
+		CHECK(InstallTaskSpec(store, TASK_NAME, MakeSpec(), L"transition fixer") == TaskInstallResult::UpToDate);
+		CHECK(store.tasks.count(TASK_NAME) == 1);
+
+		// An old task that is already gone doesn't get in the way either.
+		CHECK(InstallTaskSpec(store, TASK_NAME, MakeSpec(), L"Old Name") == TaskInstallResult::UpToDate);
+		CHECK(store.tasks.count(TASK_NAME) == 1);
+	}
+
+	void UninstallRemovesTheInstalledName()
+	{
+		FakeTaskStore store;
+		store.tasks[L"Old Name"] = MakeSpec();
+
+		CHECK(UninstallTaskSpec(store, TASK_NAME, L"Old Name"));
+		CHECK(store.tasks.empty());
+		CHECK(!UninstallTaskSpec(store, TASK_NAME, L"Old Name"));
+
+		store.tasks[TASK_NAME] = MakeSpec();
+		CHECK(UninstallTaskSpec(store, TASK_NAME));
+		CHECK(store.tasks.empty());
+	}
+
+	void HashDependsOnFieldBoundaries()
+	{
+		// Moving characters from one field to the next must change the hash.
+		TaskSpec first = MakeSpec();
+		first.author = L"ab";
+		first.description = L"c";
+
+		TaskSpec second = MakeSpec();
+		second.author = L"a";
+		second.description = L"bc";
+
+		CHECK(HashTaskSpec(first) != HashTaskSpec(second));
+		CHECK(HashTaskSpec(first) == HashTaskSpec(first));
+	}
+}
+
+int main()
+{
+	RUN_TEST(MissingTaskIsSaved);
+	RUN_TEST(IdenticalTaskIsUpToDate);
+	RUN_TEST(EachChangedFieldIsSaved);
+	RUN_TEST(DifferentlyCasedUserIsUpToDate);
+	RUN_TEST(RenamedTaskReplacesTheOldOne);
+	RUN_TEST(UninstallRemovesTheInstalledName);
+	RUN_TEST(HashDependsOnFieldBoundaries);
+
+	return TEST_EXIT_CODE();
+}
@@ -0,0 +1,42 @@
+#ifndef TEST_H
+#define TEST_H
+
+#include <iostream>
+
+namespace Test {
+	/// <summary>
+	/// Gets the number of checks that have failed so far.
+	/// </summary>
+	inline int& GetFailureCount()
+	{
+		static int failures = 0;
+		return failures;
+	}
+}
+
+/// <summary>
+/// Fails the current test (but keeps running it) if the condition doesn't hold.
+/// </summary>
+#define CHECK(condition) \
+	do { \
+		if (!(condition)) { \
+			std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #condition ") failed\n"; \
+			++Test::GetFailureCount(); \
+		} \
+	} while (0)
+
+/// <summary>
+/// Runs a test function, printing its name first.
+/// </summary>
+#define RUN_TEST(test) \
+	do { \
+		std::cout << "[ RUN  ] " #test "\n"; \
+		test(); \
+	} while (0)
+
+/// <summary>
+/// Gets the exit code for the test program: 0 if every check passed, else 1.
+/// </summary>
+#define TEST_EXIT_CODE() (Test::GetFailureCount() == 0 ? 0 : 1)
+
+#endif
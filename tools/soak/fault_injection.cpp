@@ -0,0 +1,102 @@
+#include "fault_injection.h"
+
+#include <thread>
+
+FaultInjector::FaultInjector(const FaultProfile& profile, std::uint64_t seed)
+	: m_profile(profile), m_random(seed), m_distribution(0.0, 1.0)
+{
+}
+
+FaultInjector::Fault FaultInjector::Next(const char* call)
+{
+	Delay(m_profile.latency);
+	if (m_distribution(m_random) < m_profile.latencySpikeProbability) {
+		Delay(m_profile.latencySpike);
+	}
+
+	// NOTE: A single roll decides between the faults, so that their probabilities add up the
+	// way you'd expect them to.
+	double roll = m_distribution(m_random);
+	if (roll < m_profile.exceptionProbability) {
+		throw InjectedFault(std::string("Injected fault in ") + call);
+	}
+
+	roll -= m_profile.exceptionProbability;
+	if (roll < m_profile.timeoutProbability) {
+		Delay(m_profile.timeout);
+		return Fault::Timeout;
+	}
+
+	roll -= m_profile.timeoutProbability;
+	if (roll < m_profile.failureProbability) {
+		return Fault::Failure;
+	}
+
+	return Fault::None;
+}
+
+void FaultInjector::Delay(std::chrono::microseconds duration)
+{
+	if (duration.count() <= 0) {
+		return;
+	}
+
+	m_elapsed += duration;
+	if (m_profile.sleep) {
+		std::this_thread::sleep_for(duration);
+	}
+}
+
+SendResult FaultyMessageSender::Send(const MessageVariant& variant)
+{
+	if (m_injector.Next("MessageSender::Send") != FaultInjector::Fault::None) {
+		return SendResult::NotResponding;
+	}
+
+	return m_inner.Send(variant);
+}
+
+bool FaultyProbeCache::TryGet(const std::wstring& key, std::uint32_t& index)
+{
+	if (m_injector.Next("ProbeCache::TryGet") != FaultInjector::Fault::None) {
+		return false;
+	}
+
+	return m_inner.TryGet(key, index);
+}
+
+void FaultyProbeCache::Set(const std::wstring& key, std::uint32_t index)
+{
+	if (m_injector.Next("ProbeCache::Set") != FaultInjector::Fault::None) {
+		return;
+	}
+
+	m_inner.Set(key, index);
+}
+
+bool FaultyTaskStore::TryGetTask(const std::wstring& name, TaskSpec& spec)
+{
+	if (m_injector.Next("TaskStore::TryGetTask") != FaultInjector::Fault::None) {
+		return false;
+	}
+
+	return m_inner.TryGetTask(name, spec);
+}
+
+void FaultyTaskStore::SaveTask(const std::wstring& name, const TaskSpec& spec)
+{
+	if (m_injector.Next("TaskStore::SaveTask") != FaultInjector::Fault::None) {
+		throw InjectedFault("Injected fault in TaskStore::SaveTask");
+	}
+
+	m_inner.SaveTask(name, spec);
+}
+
+bool FaultyTaskStore::DeleteTask(const std::wstring& name)
+{
+	if (m_injector.Next("TaskStore::DeleteTask") != FaultInjector::Fault::None) {
+		return false;
+	}
+
+	return m_inner.DeleteTask(name);
+}
@@ -0,0 +1,156 @@
+#ifndef FAULT_INJECTION_H
+#define FAULT_INJECTION_H
+
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <stdexcept>
+#include <string>
+
+#include "message_probe.h"
+#include "task_definition.h"
+
+/// <summary>
+/// How often (and how badly) calls through a <see cref="FaultInjector" /> misbehave.
+/// </summary>
+struct FaultProfile {
+	/// <summary>The probability that a call fails outright (e.g. SendMessageTimeout returning 0).</summary>
+	double failureProbability = 0.0;
+
+	/// <summary>The probability that a call times out. It fails after taking <see cref="timeout" />.</summary>
+	double timeoutProbability = 0.0;
+
+	/// <summary>The probability that a call throws (e.g. THROW_IF_FAILED on a failed HRESULT).</summary>
+	double exceptionProbability = 0.0;
+
+	/// <summary>The latency every call takes.</summary>
+	std::chrono::microseconds latency{ 0 };
+
+	/// <summary>The probability that a call takes <see cref="latencySpike" /> on top of <see cref="latency" />, e.g. when Explorer hangs.</summary>
+	double latencySpikeProbability = 0.0;
+
+	std::chrono::microseconds latencySpike{ 0 };
+
+	/// <summary>How long a call that times out takes.</summary>
+	std::chrono::microseconds timeout{ 500000 };
+
+	/// <summary>
+	/// Whether to actually sleep for the latency. If not, the latency is only added to
+	/// <see cref="FaultInjector::GetElapsed" />, which is what the soak harness does so that it
+	/// can simulate millions of calls.
+	/// </summary>
+	bool sleep = false;
+};
+
+/// <summary>
+/// The exception thrown for an injected fault.
+/// </summary>
+class InjectedFault : public std::runtime_error {
+public:
+	explicit InjectedFault(const std::string& what)
+		: std::runtime_error(what)
+	{
+	}
+};
+
+/// <summary>
+/// Decides, for every call, whether (and how) it should misbehave.
+/// </summary>
+class FaultInjector {
+public:
+	enum class Fault {
+		None,
+		Failure,
+		Timeout,
+	};
+
+	FaultInjector(const FaultProfile& profile, std::uint64_t seed);
+
+	/// <summary>
+	/// Injects the latency for a call and decides how it should misbehave.
+	/// </summary>
+	/// <param name="call">The name of the call, used in the message of <see cref="InjectedFault" />.</param>
+	/// <returns>The fault to inject.</returns>
+	/// <exception cref="InjectedFault">The call should throw.</exception>
+	Fault Next(const char* call);
+
+	/// <summary>
+	/// Gets the latency that has been injected since the last call to <see cref="ResetElapsed" />.
+	/// </summary>
+	std::chrono::microseconds GetElapsed() const
+	{
+		return m_elapsed;
+	}
+
+	void ResetElapsed()
+	{
+		m_elapsed = std::chrono::microseconds{ 0 };
+	}
+
+private:
+	void Delay(std::chrono::microseconds duration);
+
+	FaultProfile m_profile;
+	std::mt19937_64 m_random;
+	std::uniform_real_distribution<double> m_distribution;
+	std::chrono::microseconds m_elapsed{ 0 };
+};
+
+/// <summary>
+/// A <see cref="MessageSender" /> that injects faults in front of another one. Failures and
+/// timeouts are reported as the window not responding.
+/// </summary>
+class FaultyMessageSender : public MessageSender {
+public:
+	FaultyMessageSender(MessageSender& inner, FaultInjector& injector)
+		: m_inner(inner), m_injector(injector)
+	{
+	}
+
+	SendResult Send(const MessageVariant& variant) override;
+
+private:
+	MessageSender& m_inner;
+	FaultInjector& m_injector;
+};
+
+/// <summary>
+/// A <see cref="ProbeCache" /> that injects faults in front of another one. A failed read
+/// behaves like a cache miss, and a failed write is dropped.
+/// </summary>
+class FaultyProbeCache : public ProbeCache {
+public:
+	FaultyProbeCache(ProbeCache& inner, FaultInjector& injector)
+		: m_inner(inner), m_injector(injector)
+	{
+	}
+
+	bool TryGet(const std::wstring& key, std::uint32_t& index) override;
+	void Set(const std::wstring& key, std::uint32_t index) override;
+
+private:
+	ProbeCache& m_inner;
+	FaultInjector& m_injector;
+};
+
+/// <summary>
+/// A <see cref="TaskStore" /> that injects faults in front of another one. Saving can't report a
+/// failure other than by throwing, so failures and timeouts when saving throw as well.
+/// </summary>
+class FaultyTaskStore : public TaskStore {
+public:
+	FaultyTaskStore(TaskStore& inner, FaultInjector& injector)
+		: m_inner(inner), m_injector(injector)
+	{
+	}
+
+	bool TryGetTask(const std::wstring& name, TaskSpec& spec) override;
+	void SaveTask(const std::wstring& name, const TaskSpec& spec) override;
+	bool DeleteTask(const std::wstring& name) override;
+
+private:
+	TaskStore& m_inner;
+	FaultInjector& m_injector;
+};
+
+#endif
@@ -0,0 +1,347 @@
+// Soak harness for the platform-independent parts of TransitionFixer.
+//
+// Simulates millions of invocations of the run or install-task mode against the fakes from
+// tests/fakes.h, wrapped in the fault-injection layer, then reports throughput, tail latency and
+// the distribution of exit codes. Each invocation logs its outcome to an in-memory journal, as
+// LogInfo and LogError do when the event log isn't available. Injected latency is simulated
+// rather than slept, so the latency percentiles are what the invocations would have taken, while
+// the throughput is what the code itself managed.
+//
+// Build and run from the repository root:
+//
+//     g++ -std=c++17 -O2 -I. -o soak tools/soak/soak.cpp tools/soak/fault_injection.cpp journal.cpp message_probe.cpp task_definition.cpp -lboost_program_options
+//     ./soak --mode run --iterations 5000000 --failure 0.01 --timeout 0.001 --spike 0.0005
+//
+// tests/Makefile also builds it and runs a short smoke test of both modes as part of "make check".
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/program_options.hpp>
+
+#include <sys/resource.h>
+
+#include "exit_code.h"
+#include "fault_injection.h"
+#include "journal.h"
+#include "message_probe.h"
+#include "task_definition.h"
+#include "tests/fakes.h"
+
+namespace po = boost::program_options;
+
+namespace {
+	// The same size as the journal that LogInfo and LogError fall back to.
+	constexpr std::size_t JOURNAL_CAPACITY = 256 * 1024;
+
+	/// <summary>
+	/// Formats what ApplyFadeFix logs for a failed probe, so that the journal gets messages of the
+	/// same shape and size as the real ones.
+	/// </summary>
+	std::wstring FormatProbeError(const ProbeResult& result, std::size_t variantCount)
+	{
+		std::wstringstream error;
+		if (!result.windowFound) {
+			error << "Failed to locate Progman: Invalid window handle.";
+		}
+		else if (result.notResponding) {
+			error << "Failed to send message to Progman: This operation returned because the timeout period expired.";
+		}
+		else {
+			error << "None of the " << variantCount << " message variants enabled Active Desktop";
+		}
+
+		return error.str();
+	}
+
+	long GetMaxResidentSetKiB()
+	{
+		rusage usage = {};
+		getrusage(RUSAGE_SELF, &usage);
+
+		return usage.ru_maxrss;
+	}
+
+	std::int64_t GetPercentile(std::vector<std::int64_t>& values, double percentile)
+	{
+		if (values.empty()) {
+			return 0;
+		}
+
+		auto index = static_cast<std::size_t>(percentile * static_cast<double>(values.size() - 1));
+		std::nth_element(values.begin(), values.begin() + index, values.end());
+
+		return values[index];
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	po::options_description opts("Allowed Options");
+	opts.add_options()
+		("help", "Show this help message")
+		("mode", po::value<std::string>()->default_value("run"), "The mode to simulate (run or install-task)")
+		("iterations", po::value<std::uint64_t>()->default_value(1000000), "The number of invocations to simulate")
+		("seed", po::value<std::uint64_t>()->default_value(1), "The seed for the fault injector")
+		("failure", po::value<double>()->default_value(0.0), "The probability that a platform call fails")
+		("timeout", po::value<double>()->default_value(0.0), "The probability that a platform call times out")
+		("exception", po::value<double>()->default_value(0.0), "The probability that a platform call throws")
+		("latency-us", po::value<std::int64_t>()->default_value(50), "The latency of every platform call, in microseconds")
+		("spike", po::value<double>()->default_value(0.0), "The probability of a latency spike on a platform call")
+		("spike-us", po::value<std::int64_t>()->default_value(250000), "The length of a latency spike, in microseconds")
+		("timeout-us", po::value<std::int64_t>()->default_value(500000), "How long a call that times out takes, in microseconds")
+		("change", po::value<double>()->default_value(0.0),
+			"The probability that the environment changes between invocations "
+			"(the variant the shell accepts for run, the task definition for install-task)")
+		("missing", po::value<double>()->default_value(0.0),
+			"run: The probability that the shell's window doesn't exist for an invocation (e.g. Explorer is restarting)")
+		("min-success", po::value<double>()->default_value(0.0),
+			"Exit with an error if fewer than this fraction of invocations succeed");
+
+	po::variables_map vm;
+	try {
+		po::store(po::parse_command_line(argc, argv, opts), vm);
+		po::notify(vm);
+	}
+	catch (const po::error& ex) {
+		std::cerr
+			<< "Error: " << ex.what() << "\n"
+			<< opts
+			<< std::endl;
+
+		return ExitCode::ERR_CMDLINE_ERROR;
+	}
+
+	if (vm.count("help")) {
+		std::cout << opts << std::endl;
+		return ExitCode::ERR_SUCCESS;
+	}
+
+	std::string mode = vm["mode"].as<std::string>();
+	if (mode != "run" && mode != "install-task") {
+		std::cerr
+			<< "Error: Unrecognized mode '" << mode << "'\n"
+			<< opts
+			<< std::endl;
+
+		return ExitCode::ERR_CMDLINE_ERROR;
+	}
+
+	FaultProfile profile;
+	profile.failureProbability = vm["failure"].as<double>();
+	profile.timeoutProbability = vm["timeout"].as<double>();
+	profile.exceptionProbability = vm["exception"].as<double>();
+	profile.latency = std::chrono::microseconds(vm["latency-us"].as<std::int64_t>());
+	profile.latencySpikeProbability = vm["spike"].as<double>();
+	profile.latencySpike = std::chrono::microseconds(vm["spike-us"].as<std::int64_t>());
+	profile.timeout = std::chrono::microseconds(vm["timeout-us"].as<std::int64_t>());
+
+	const std::uint64_t iterations = vm["iterations"].as<std::uint64_t>();
+	const std::uint64_t seed = vm["seed"].as<std::uint64_t>();
+	const double changeProbability = vm["change"].as<double>();
+	const double missingProbability = vm["missing"].as<double>();
+	const double minSuccess = vm["min-success"].as<double>();
+
+	FaultInjector injector(profile, seed);
+	std::mt19937_64 environmentRandom(seed ^ 0x9E3779B97F4A7C15ULL);
+	std::uniform_real_distribution<double> distribution(0.0, 1.0);
+
+	std::vector<MessageVariant> variants = GetKnownMessageVariants({ L"Progman" });
+	std::wstring cacheKey = MakeProbeCacheKey(L"19045", L"explorer.exe", variants);
+	FakeMessageSender shell;
+	shell.variants = variants;
+	FakeProbeCache cache;
+	FaultyMessageSender sender(shell, injector);
+	FaultyProbeCache faultyCache(cache, injector);
+
+	FakeTaskStore store;
+	FaultyTaskStore faultyStore(store, injector);
+	TaskSpec spec;
+	spec.author = L"Limotto Productions";
+	spec.version = L"1.0";
+	spec.startWhenAvailable = true;
+	spec.userID = L"DOMAIN\\user";
+	spec.delay = L"PT30S";
+	spec.path = L"C:\\Program Files\\TransitionFixer\\TransitionFixer.exe";
+	spec.workingDirectory = L"C:\\Program Files\\TransitionFixer";
+	spec.arguments = L"run";
+
+	// Every invocation logs its outcome, which ends up in the journal whenever the event log
+	// can't be written to (e.g. when its source isn't installed), so assume that it always does.
+	std::vector<std::uint64_t> journalBlock((GetJournalSize(JOURNAL_CAPACITY) + 7) / 8, 0);
+	JournalWriter journal;
+	if (!journal.Attach(journalBlock.data(), journalBlock.size() * sizeof(std::uint64_t))) {
+		std::cerr << "Error: Failed to attach the journal\n";
+		return ExitCode::ERR_FAILURE;
+	}
+
+	std::uint64_t journalAppends = 0;
+	auto log = [&](JournalLevel level, const std::wstring& message) {
+		if (journal.Append(level, GetJournalTimestamp(), message)) {
+			++journalAppends;
+		}
+	};
+
+	// NOTE: This is filled up front (rather than just reserved) so that its pages are already
+	// counted in the resident set before the loop starts.
+	std::vector<std::int64_t> latencies(static_cast<std::size_t>(iterations), 0);
+	std::map<int, std::uint64_t> exitCodes;
+	std::map<std::size_t, std::uint64_t> attempts;
+	std::uint64_t cacheHits = 0;
+	std::uint64_t noEffect = 0;
+	std::uint64_t notDelivered = 0;
+	std::uint64_t exceptions = 0;
+
+	// Anything allocated up front is done by now, so growth from here on out points at a leak.
+	const long startResidentSet = GetMaxResidentSetKiB();
+	auto start = std::chrono::steady_clock::now();
+
+	for (std::uint64_t i = 0; i < iterations; ++i) {
+		if (distribution(environmentRandom) < changeProbability) {
+			if (mode == "run") {
+				shell.acceptedIndex = static_cast<std::size_t>(environmentRandom() % variants.size());
+			}
+			else {
+				spec.version = std::to_wstring(i);
+			}
+		}
+
+		if (mode == "run") {
+			// Every invocation is a new logon, with Active Desktop disabled again. The shell's
+			// window might not exist yet, e.g. while Explorer is restarting.
+			shell.activeDesktopEnabled = false;
+			shell.missingClasses.clear();
+			if (distribution(environmentRandom) < missingProbability) {
+				shell.missingClasses.push_back(L"Progman");
+			}
+
+			shell.sent.clear();
+		}
+
+		injector.ResetElapsed();
+
+		// Mirror what main() does with the result: an exception that isn't a command line error
+		// is reported as a failure.
+		int exitCode = ExitCode::ERR_FAILURE;
+		try {
+			if (mode == "run") {
+				ProbeResult result = ProbeAndSend(sender, faultyCache, cacheKey, variants);
+				++attempts[result.attempts];
+				if (result.fromCache) {
+					++cacheHits;
+				}
+
+				if (result.notResponding || !result.windowFound) {
+					++notDelivered;
+				}
+				else if (!result.succeeded) {
+					++noEffect;
+				}
+
+				if (result.succeeded) {
+					log(JournalLevel::Info, L"Successfully enabled Active Desktop");
+					exitCode = ExitCode::ERR_SUCCESS;
+				}
+				else {
+					log(JournalLevel::Error, FormatProbeError(result, variants.size()));
+				}
+			}
+			else {
+				if (InstallTaskSpec(faultyStore, L"Transition Fixer", spec) == TaskInstallResult::UpToDate) {
+					log(JournalLevel::Info, L"Task in Windows Task Scheduler is already up to date, skipped installing it");
+				}
+				else {
+					log(JournalLevel::Info, L"Successfully installed task into Windows Task Scheduler");
+				}
+
+				exitCode = ExitCode::ERR_SUCCESS;
+			}
+		}
+		catch (const std::exception& ex) {
+			++exceptions;
+
+			std::string what = ex.what();
+			log(JournalLevel::Error, std::wstring(what.begin(), what.end()));
+		}
+
+		++exitCodes[exitCode];
+		latencies[static_cast<std::size_t>(i)] = injector.GetElapsed().count();
+	}
+
+	auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	const long endResidentSet = GetMaxResidentSetKiB();
+
+	// Whatever the journal has wrapped around to, it has to be readable afterwards.
+	std::uint64_t journalRecords = 0;
+	std::uint64_t journalErrors = 0;
+	bool journalRead = ReadJournal(journalBlock.data(), journalBlock.size() * sizeof(std::uint64_t), JournalFilter(), [&](const JournalRecord& record) {
+		++journalRecords;
+		if (record.level == JournalLevel::Error) {
+			++journalErrors;
+		}
+	});
+
+	std::cout << std::fixed << std::setprecision(2);
+	std::cout
+		<< "mode:          " << mode << "\n"
+		<< "invocations:   " << iterations << "\n"
+		<< "wall time:     " << elapsed << " s\n"
+		<< "throughput:    " << (elapsed > 0 ? static_cast<double>(iterations) / elapsed : 0.0) << " invocations/s\n"
+		<< "exceptions:    " << exceptions << "\n"
+		<< "journal:       " << journalAppends << " appended, " << journalRecords << " still readable (" << journalErrors << " errors)\n";
+
+	if (mode == "run") {
+		std::cout
+			<< "cache hits:    " << cacheHits << "\n"
+			<< "no effect:     " << noEffect << "\n"
+			<< "not delivered: " << notDelivered << "\n";
+		std::cout << "attempts:\n";
+		for (const auto& entry : attempts) {
+			std::cout << "  " << entry.first << ": " << entry.second << "\n";
+		}
+	}
+	else {
+		std::cout << "task saves:    " << store.saves << "\n";
+	}
+
+	std::cout << "simulated latency (us):\n";
+	std::cout
+		<< "  p50:   " << GetPercentile(latencies, 0.50) << "\n"
+		<< "  p90:   " << GetPercentile(latencies, 0.90) << "\n"
+		<< "  p99:   " << GetPercentile(latencies, 0.99) << "\n"
+		<< "  p99.9: " << GetPercentile(latencies, 0.999) << "\n"
+		<< "  max:   " << GetPercentile(latencies, 1.0) << "\n";
+
+	std::cout << "exit codes:\n";
+	for (const auto& entry : exitCodes) {
+		std::cout
+			<< "  " << entry.first << ": " << entry.second
+			<< " (" << 100.0 * static_cast<double>(entry.second) / static_cast<double>(iterations) << "%)\n";
+	}
+
+	std::cout
+		<< "max RSS:       " << startResidentSet << " KiB before, " << endResidentSet << " KiB after"
+		<< std::endl;
+
+	const double successRate = iterations > 0
+		? static_cast<double>(exitCodes[ExitCode::ERR_SUCCESS]) / static_cast<double>(iterations)
+		: 1.0;
+	if (!journalRead || (journalAppends > 0 && journalRecords == 0)) {
+		std::cerr << "Error: The journal could not be read back\n";
+		return ExitCode::ERR_FAILURE;
+	}
+
+	if (successRate < minSuccess) {
+		std::cerr << "Error: Only " << 100.0 * successRate << "% of invocations succeeded\n";
+		return ExitCode::ERR_FAILURE;
+	}
+
+	return ExitCode::ERR_SUCCESS;
+}
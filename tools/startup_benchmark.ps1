@@ -0,0 +1,82 @@
+<#
+.SYNOPSIS
+    Measures the startup cost of TransitionFixer and fails if it regresses.
+
+.DESCRIPTION
+    Runs TransitionFixer.exe with --startup-stats a number of times for each mode and reports the
+    median number of modules loaded, page faults, time to main() and total time. If any median goes
+    over its limit, the script exits with a non-zero exit code.
+
+    The defaults only cover the "run" mode, since that's the one on the logon-critical path (and
+    the other modes need to be run elevated).
+
+.EXAMPLE
+    .\tools\startup_benchmark.ps1 -Exe .\x64\Release\TransitionFixer.exe -MaxModules 12
+#>
+param(
+    [Parameter(Mandatory = $true)]
+    [string] $Exe,
+
+    [string[]] $Modes = @("run"),
+
+    [int] $Iterations = 20,
+
+    [int] $MaxModules = 16,
+
+    [int] $MaxPageFaults = 1500,
+
+    [double] $MaxTimeToMainMs = 50.0
+)
+
+function Get-Median([double[]] $Values)
+{
+    $sorted = $Values | Sort-Object
+    return $sorted[[int][Math]::Floor($sorted.Count / 2)]
+}
+
+$failed = $false
+foreach ($mode in $Modes) {
+    $samples = @()
+    for ($i = 0; $i -lt $Iterations; $i++) {
+        $line = & $Exe $mode --startup-stats 2>&1 |
+            ForEach-Object { "$_" } |
+            Where-Object { $_ -like "startup-stats *" } |
+            Select-Object -Last 1
+        if (-not $line) {
+            Write-Error "No startup stats were printed for mode '$mode'"
+            exit 1
+        }
+
+        $sample = @{}
+        foreach ($pair in $line.Split(" ") | Select-Object -Skip 1) {
+            $key, $value = $pair.Split("=", 2)
+            $sample[$key] = $value
+        }
+        $samples += $sample
+    }
+
+    $modules = Get-Median ($samples | ForEach-Object { [double]$_["modules"] })
+    $pageFaults = Get-Median ($samples | ForEach-Object { [double]$_["page-faults"] })
+    $timeToMain = Get-Median ($samples | ForEach-Object { [double]$_["time-to-main-ms"] })
+    $total = Get-Median ($samples | ForEach-Object { [double]$_["total-ms"] })
+
+    Write-Host ("{0}: modules={1} page-faults={2} time-to-main-ms={3:N3} total-ms={4:N3}" -f `
+        $mode, $modules, $pageFaults, $timeToMain, $total)
+
+    if ($modules -gt $MaxModules) {
+        Write-Host "  FAIL: $modules modules loaded (limit: $MaxModules)"
+        $failed = $true
+    }
+    if ($pageFaults -gt $MaxPageFaults) {
+        Write-Host "  FAIL: $pageFaults page faults (limit: $MaxPageFaults)"
+        $failed = $true
+    }
+    if ($timeToMain -gt $MaxTimeToMainMs) {
+        Write-Host "  FAIL: $timeToMain ms to main (limit: $MaxTimeToMainMs ms)"
+        $failed = $true
+    }
+}
+
+if ($failed) {
+    exit 1
+}
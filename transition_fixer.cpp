@@ -7,40 +7,207 @@
 
 #include <Windows.h>
 
+#include "config.h"
 #include "event_log.h"
+#include "message_probe.h"
 #include "utils.h"
 
 namespace {
-	constexpr LPCWSTR PROGMAN_NAME = L"Progman";
-	constexpr UINT DEFAULT_TIMEOUT = 500;
-	constexpr UINT WM_ENABLE_ACTIVEDESKTOP = WM_USER + 0x12C;
+	constexpr LPCWSTR CURRENT_VERSION_KEY = L"SOFTWARE\\Microsoft\\Windows NT\\CurrentVersion";
+	constexpr LPCWSTR WINLOGON_KEY = L"SOFTWARE\\Microsoft\\Windows NT\\CurrentVersion\\Winlogon";
+	constexpr LPCWSTR PROBE_CACHE_KEY = L"SOFTWARE\\TransitionFixer\\ProbeCache";
+
+	std::wstring GetOSBuild()
+	{
+		return GetRegistryString(HKEY_LOCAL_MACHINE, CURRENT_VERSION_KEY, L"CurrentBuildNumber");
+	}
+
+	std::wstring GetShell()
+	{
+		// A per-user shell replacement takes precedence over the machine-wide one.
+		std::wstring shell = GetRegistryString(HKEY_CURRENT_USER, WINLOGON_KEY, L"Shell");
+		if (shell.empty()) {
+			shell = GetRegistryString(HKEY_LOCAL_MACHINE, WINLOGON_KEY, L"Shell");
+		}
+
+		return shell;
+	}
+
+	/// <summary>
+	/// Whether Active Desktop is enabled, as far as can be told from the desktop's windows.
+	/// </summary>
+	enum class ActiveDesktopState {
+		Enabled,
+		Disabled,
+		Unknown,
+	};
+
+	BOOL CALLBACK FindWallpaperWorker(HWND window, LPARAM param)
+	{
+		// Once Active Desktop is enabled, the desktop icons (SHELLDLL_DefView) are moved into a
+		// top-level WorkerW window, and the wallpaper is drawn into a second WorkerW right after it.
+		HWND defView = FindWindowExW(window, nullptr, L"SHELLDLL_DefView", nullptr);
+		if (defView == nullptr) {
+			return TRUE;
+		}
+
+		*reinterpret_cast<HWND*>(param) = FindWindowExW(nullptr, window, L"WorkerW", nullptr);
+		return FALSE;
+	}
+
+	ActiveDesktopState GetActiveDesktopState()
+	{
+		// Newer builds (e.g. Windows 11 24H2) leave the icons in Progman, and draw the wallpaper
+		// into a WorkerW that is a child of Progman instead.
+		HWND progman = FindWindowW(L"Progman", nullptr);
+		if (progman != nullptr && FindWindowExW(progman, nullptr, L"WorkerW", nullptr) != nullptr) {
+			return ActiveDesktopState::Enabled;
+		}
+
+		HWND wallpaperWorker = nullptr;
+		EnumWindows(FindWallpaperWorker, reinterpret_cast<LPARAM>(&wallpaperWorker));
+		if (wallpaperWorker != nullptr) {
+			return ActiveDesktopState::Enabled;
+		}
+
+		// The icons still being in Progman, with no WorkerW anywhere, is what the desktop looks
+		// like before Active Desktop is enabled. Anything else (e.g. a shell replacement) is a
+		// layout we don't know, so we can't tell either way.
+		if (progman != nullptr && FindWindowExW(progman, nullptr, L"SHELLDLL_DefView", nullptr) != nullptr) {
+			return ActiveDesktopState::Disabled;
+		}
+
+		return ActiveDesktopState::Unknown;
+	}
+
+	/// <summary>
+	/// Sends messages to top-level windows using SendMessageTimeout, and checks whether Active
+	/// Desktop was enabled afterwards.
+	/// </summary>
+	class Win32MessageSender : public MessageSender {
+	public:
+		SendResult Send(const MessageVariant& variant) override
+		{
+			// Look for the target window. For the default variant, this is "Progman", the
+			// window that is responsible for displaying the user's wallpaper.
+			HWND windowHandle = FindWindowW(variant.windowClass.c_str(), nullptr);
+			if (windowHandle == nullptr) {
+				std::wstringstream error;
+				error << "Failed to locate " << variant.windowClass << ": ";
+				error << GetLastWin32Error();
+
+				m_lastError = error.str();
+				return SendResult::WindowNotFound;
+			}
+
+			// Now send a message to it so that it'll enable Active Desktop.
+			ULONGLONG output = 0;
+			LRESULT result = SendMessageTimeoutW(windowHandle,
+								variant.message,
+								static_cast<WPARAM>(variant.wParam),
+								static_cast<LPARAM>(variant.lParam),
+								SMTO_NORMAL,
+								GetConfig().timeoutMs,
+								&output);
+			if (result == 0) {
+				std::wstringstream error;
+				error << "Failed to send message to " << variant.windowClass << ": ";
+				error << GetLastWin32Error();
+
+				m_lastError = error.str();
+				return SendResult::NotResponding;
+			}
+
+			// A delivered message isn't enough: some builds accept the message but ignore it, so
+			// check that it actually did something.
+			ActiveDesktopState state = GetActiveDesktopState();
+			if (state == ActiveDesktopState::Unknown) {
+				return SendResult::Unconfirmed;
+			}
+
+			if (state == ActiveDesktopState::Disabled) {
+				std::wstringstream error;
+				error << "Message " << std::hex << std::showbase << variant.message
+					<< " (wParam " << variant.wParam << ", lParam " << variant.lParam << ")"
+					<< " was delivered to " << variant.windowClass << ", but did not enable Active Desktop";
+
+				m_lastError = error.str();
+				return SendResult::NoEffect;
+			}
+
+			return SendResult::Applied;
+		}
+
+		const std::wstring& GetLastErrorMessage() const
+		{
+			return m_lastError;
+		}
+
+	private:
+		std::wstring m_lastError;
+	};
+
+	/// <summary>
+	/// A <see cref="ProbeCache" /> that is stored under the current user's registry hive.
+	/// </summary>
+	class RegistryProbeCache : public ProbeCache {
+	public:
+		bool TryGet(const std::wstring& key, std::uint32_t& index) override
+		{
+			DWORD value = 0;
+			DWORD size = sizeof(value);
+			LSTATUS status = RegGetValueW(
+				HKEY_CURRENT_USER,
+				PROBE_CACHE_KEY,
+				key.c_str(),
+				RRF_RT_REG_DWORD,
+				nullptr,
+				&value,
+				&size);
+			if (status != ERROR_SUCCESS) {
+				return false;
+			}
+
+			index = value;
+			return true;
+		}
+
+		void Set(const std::wstring& key, std::uint32_t index) override
+		{
+			// The cache is purely an optimization, so failing to write to it isn't an error.
+			const DWORD value = index;
+			RegSetKeyValueW(
+				HKEY_CURRENT_USER,
+				PROBE_CACHE_KEY,
+				key.c_str(),
+				REG_DWORD,
+				&value,
+				sizeof(value));
+		}
+	};
 }
 
 bool ApplyFadeFix()
 {
-	// Look for the "Progman" handle. This is the handle to the window that is responsible for
-	// displaying the user's wallpaper.
-	HWND progmanHandle = FindWindowW(PROGMAN_NAME, nullptr);
-	if (progmanHandle == nullptr) {
-		std::wstringstream error;
-		error << "Failed to locate " << PROGMAN_NAME << ": ";
-		error << GetLastWin32Error();
+	// Nothing to do if something (e.g. a previous run) already enabled Active Desktop.
+	if (GetActiveDesktopState() == ActiveDesktopState::Enabled) {
+		return true;
+	}
 
-		LogError(error.str());
+	std::vector<MessageVariant> variants = GetKnownMessageVariants(GetConfig().targets);
+	std::wstring cacheKey = MakeProbeCacheKey(GetOSBuild(), GetShell(), variants);
+
+	Win32MessageSender sender;
+	RegistryProbeCache cache;
+	ProbeResult result = ProbeAndSend(sender, cache, cacheKey, variants);
+	if (!result.succeeded && (result.notResponding || !result.windowFound)) {
+		LogError(sender.GetLastErrorMessage());
 		return false;
 	}
 
-	// Now send a message to it so that it'll enable Active Desktop.
-	ULONGLONG output = 0;
-	LRESULT result = SendMessageTimeoutW(progmanHandle,
-						WM_ENABLE_ACTIVEDESKTOP,
-						NULL, NULL, SMTO_NORMAL,
-						DEFAULT_TIMEOUT,
-						&output);
-	if (result == 0) {
+	if (!result.succeeded) {
 		std::wstringstream error;
-		error << "Failed to send message to " << PROGMAN_NAME << ": ";
-		error << GetLastWin32Error();
+		error << "None of the " << variants.size() << " message variants enabled Active Desktop";
 
 		LogError(error.str());
 		return false;
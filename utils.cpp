@@ -1,6 +1,5 @@
 #include "utils.h"
 
-#include <atlstr.h>
 #include <Windows.h>
 
 std::wstring GetExePath()
@@ -43,3 +42,40 @@ std::wstring GetLastWin32Error()
 
 	return GetWin32Error(lastError);
 }
+
+std::wstring ToWideString(const std::string& value)
+{
+	if (value.empty()) {
+		return std::wstring();
+	}
+
+	int length = MultiByteToWideChar(CP_ACP, 0, value.c_str(), static_cast<int>(value.size()), nullptr, 0);
+	if (length == 0) {
+		return std::wstring();
+	}
+
+	std::wstring result(length, L'\0');
+	MultiByteToWideChar(CP_ACP, 0, value.c_str(), static_cast<int>(value.size()), &result[0], length);
+
+	return result;
+}
+
+std::wstring GetRegistryString(HKEY root, LPCWSTR subKey, LPCWSTR valueName)
+{
+	// Ask for the size first, so that we know how big of a buffer we need.
+	DWORD size = 0;
+	LSTATUS status = RegGetValueW(root, subKey, valueName, RRF_RT_REG_SZ, nullptr, nullptr, &size);
+	if (status != ERROR_SUCCESS || size == 0) {
+		return std::wstring();
+	}
+
+	std::wstring value(size / sizeof(wchar_t), L'\0');
+	status = RegGetValueW(root, subKey, valueName, RRF_RT_REG_SZ, nullptr, &value[0], &size);
+	if (status != ERROR_SUCCESS) {
+		return std::wstring();
+	}
+
+	// NOTE: The size includes the null terminator, which std::wstring takes care of for us.
+	value.resize(wcsnlen(value.c_str(), value.size()));
+	return value;
+}
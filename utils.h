@@ -23,4 +23,20 @@ std::wstring GetWin32Error(DWORD errorCode);
 /// <returns>A message describing the error code.</returns>
 std::wstring GetLastWin32Error();
 
+/// <summary>
+/// Converts a string in the current code page (e.g. a command line argument) to a wide string.
+/// </summary>
+/// <param name="value">The string.</param>
+/// <returns>The wide string or an empty string if it cannot be converted.</returns>
+std::wstring ToWideString(const std::string& value);
+
+/// <summary>
+/// Reads a string value from the registry.
+/// </summary>
+/// <param name="root">The root key.</param>
+/// <param name="subKey">The path to the key, relative to the root key.</param>
+/// <param name="valueName">The name of the value.</param>
+/// <returns>The value or an empty string if it does not exist.</returns>
+std::wstring GetRegistryString(HKEY root, LPCWSTR subKey, LPCWSTR valueName);
+
 #endif
\ No newline at end of file